@@ -0,0 +1,21 @@
+#version 300 es
+
+precision highp float;
+
+in vec2 vs_texcoord;
+in vec4 vs_fgColor;
+in vec4 vs_bgColor; // x: diameter
+
+out vec4 fragColor;
+
+void main(void)
+{
+    // distance from the center, 1 on the outline
+    float distance = 2.0 * length(vs_texcoord - vec2(0.5));
+    // smooth over about a pixel, and at least half a unit of the diameter
+    float width = max(fwidth(distance), 1.0 / vs_bgColor.x);
+    float alpha = 1.0 - smoothstep(1.0 - width, 1.0, distance);
+    vec4 color = vs_fgColor;
+    color.a *= alpha;
+    fragColor = color;
+}
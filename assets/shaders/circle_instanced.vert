@@ -0,0 +1,27 @@
+#version 300 es
+
+layout(location=0) in vec2 corner;
+layout(location=1) in vec4 rect;
+layout(location=2) in vec4 texRect;
+layout(location=3) in vec4 fgColor;
+layout(location=4) in vec4 bgColor;
+layout(location=5) in mat3x2 transform;
+
+layout(std140) uniform FrameUniforms
+{
+    mat4 mvp;
+    vec4 colorMultiply;
+};
+
+out vec2 vs_texcoord;
+out vec4 vs_fgColor;
+out vec4 vs_bgColor;
+
+void main(void)
+{
+    vec2 position = transform * vec3(mix(rect.xy, rect.zw, corner), 1.0);
+    vs_texcoord = mix(texRect.xy, texRect.zw, corner);
+    vs_fgColor = fgColor * colorMultiply;
+    vs_bgColor = bgColor;
+    gl_Position = mvp * vec4(position, 0, 1);
+}
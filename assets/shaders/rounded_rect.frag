@@ -0,0 +1,40 @@
+#version 300 es
+
+precision highp float;
+
+in vec2 vs_position;
+flat in vec2 vs_halfSize;
+flat in vec3 vs_params;
+in vec4 vs_fillColor;
+in vec4 vs_borderColor;
+
+out vec4 fragColor;
+
+// signed distance to a box centered at the origin with rounded corners, negative inside
+float roundedBoxDistance(vec2 position, vec2 halfSize, float radius)
+{
+    vec2 q = abs(position) - halfSize + vec2(radius);
+    return length(max(q, 0.0)) + min(max(q.x, q.y), 0.0) - radius;
+}
+
+void main(void)
+{
+    float radius = vs_params.x;
+    float borderWidth = vs_params.y;
+    float blur = vs_params.z;
+
+    float distance = roundedBoxDistance(vs_position, vs_halfSize, radius);
+
+    // antialias over about a pixel, or fade out over the blur distance for shadows
+    float edgeWidth = max(0.5 * fwidth(distance), blur);
+    float alpha = 1.0 - smoothstep(-edgeWidth, edgeWidth, distance);
+
+    vec4 color = vs_fillColor;
+    if (borderWidth > 0.0)
+    {
+        float aa = 0.5 * fwidth(distance);
+        color = mix(vs_fillColor, vs_borderColor, smoothstep(-borderWidth - aa, -borderWidth + aa, distance));
+    }
+    color.a *= alpha;
+    fragColor = color;
+}
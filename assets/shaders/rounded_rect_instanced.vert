@@ -0,0 +1,34 @@
+#version 300 es
+
+layout(location=0) in vec2 corner;
+layout(location=1) in vec4 rect;
+layout(location=2) in vec4 params; // radius, border width, blur
+layout(location=3) in vec4 fgColor;
+layout(location=4) in vec4 bgColor;
+layout(location=5) in mat3x2 transform;
+
+layout(std140) uniform FrameUniforms
+{
+    mat4 mvp;
+    vec4 colorMultiply;
+};
+
+out vec2 vs_position;
+flat out vec2 vs_halfSize;
+flat out vec3 vs_params;
+out vec4 vs_fillColor;
+out vec4 vs_borderColor;
+
+void main(void)
+{
+    // grow the quad so that the blurred edge fits
+    float blur = params.z;
+    vec2 center = 0.5 * (rect.xy + rect.zw);
+    vec2 position = mix(rect.xy - vec2(blur), rect.zw + vec2(blur), corner);
+    vs_position = position - center;
+    vs_halfSize = 0.5 * (rect.zw - rect.xy);
+    vs_params = params.xyz;
+    vs_fillColor = fgColor * colorMultiply;
+    vs_borderColor = bgColor * colorMultiply;
+    gl_Position = mvp * vec4(transform * vec3(position, 1.0), 0, 1);
+}
@@ -3,15 +3,23 @@
 layout(location=0) in vec2 position;
 layout(location=1) in vec2 texcoord;
 layout(location=2) in vec4 color;
+layout(location=4) in float textureLayer;
+layout(location=5) in float textureSlot;
 
-uniform mat4 mvp;
+layout(std140) uniform FrameUniforms
+{
+    mat4 mvp;
+    vec4 colorMultiply;
+};
 
-out vec2 vs_texcoord;
+out vec3 vs_texcoord;
 out vec4 vs_color;
+flat out int vs_textureSlot;
 
 void main(void)
 {
-    vs_texcoord = texcoord;
-    vs_color = color;
+    vs_texcoord = vec3(texcoord, textureLayer);
+    vs_textureSlot = int(textureSlot);
+    vs_color = color * colorMultiply;
     gl_Position = mvp * vec4(position, 0, 1);
 }
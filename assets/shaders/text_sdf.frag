@@ -0,0 +1,38 @@
+#version 300 es
+
+precision highp float;
+precision highp sampler2DArray;
+
+uniform sampler2DArray baseColorTexture[8];
+
+in vec3 vs_texcoord;
+in vec4 vs_color;
+flat in int vs_textureSlot;
+
+out vec4 fragColor;
+
+// GLSL ES 3.0 only allows indexing sampler arrays with constant expressions
+float sampleTexture(vec3 texcoord)
+{
+    switch (vs_textureSlot) {
+    case 1: return texture(baseColorTexture[1], texcoord).r;
+    case 2: return texture(baseColorTexture[2], texcoord).r;
+    case 3: return texture(baseColorTexture[3], texcoord).r;
+    case 4: return texture(baseColorTexture[4], texcoord).r;
+    case 5: return texture(baseColorTexture[5], texcoord).r;
+    case 6: return texture(baseColorTexture[6], texcoord).r;
+    case 7: return texture(baseColorTexture[7], texcoord).r;
+    default: return texture(baseColorTexture[0], texcoord).r;
+    }
+}
+
+void main(void)
+{
+    // the outline is at 0.5, smooth it over about a pixel whatever the scale
+    float distance = sampleTexture(vs_texcoord);
+    float width = 0.7 * fwidth(distance);
+    float alpha = smoothstep(0.5 - width, 0.5 + width, distance);
+    vec4 color = vs_color;
+    color.a *= alpha;
+    fragColor = color;
+}
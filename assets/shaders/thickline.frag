@@ -0,0 +1,21 @@
+#version 300 es
+
+precision highp float;
+
+in vec2 vs_texcoord; // x along the line, y across it
+in vec4 vs_fgColor;
+in vec4 vs_bgColor; // x: twice the thickness
+
+out vec4 fragColor;
+
+void main(void)
+{
+    // distance from the center line, 1 on the edges
+    float distance = abs(2.0 * vs_texcoord.y - 1.0);
+    // smooth over about a pixel, and at least half a unit of the thickness
+    float width = max(fwidth(distance), 2.0 / vs_bgColor.x);
+    float alpha = 1.0 - smoothstep(1.0 - width, 1.0, distance);
+    vec4 color = vs_fgColor;
+    color.a *= alpha;
+    fragColor = color;
+}
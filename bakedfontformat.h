@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+
+// Layout of the file written by tools/fontbaker.cc and read by BakedFonts. All fields are 32 bits, in host byte order.
+namespace BakedFontFormat
+{
+constexpr std::uint32_t Magic = 0x464b4142; // "BAKF"
+constexpr std::uint32_t Version = 1;
+
+struct Header
+{
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::int32_t pageWidth;
+    std::int32_t pageHeight;
+    std::int32_t pageCount;
+    std::int32_t fontCount;
+};
+// followed by pageCount grayscale pages of pageWidth * pageHeight bytes each, then fontCount fonts
+
+constexpr int MaxFontNameLength = 64;
+
+struct Font
+{
+    char name[MaxFontNameLength]; // file name under assets/fonts, NUL terminated
+    std::int32_t pixelHeight;
+    std::int32_t distanceField;
+    std::int32_t glyphCount;
+};
+// followed by glyphCount glyphs
+
+struct Glyph
+{
+    std::int32_t codepoint;
+    std::int32_t boundingBox[4]; // x0, y0, x1, y1
+    float advanceWidth;
+    float textureCoords[4]; // u0, v0, u1, v1
+    std::int32_t page;
+    std::int32_t width;
+    std::int32_t height;
+};
+
+} // namespace BakedFontFormat
@@ -0,0 +1,122 @@
+#include "bakedfonts.h"
+
+#include "bakedfontformat.h"
+#include "ioutil.h"
+#include "log.h"
+#include "pixmap.h"
+#include "textureatlas.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+class Reader
+{
+public:
+    explicit Reader(const std::vector<unsigned char> &data)
+        : m_data(data)
+    {
+    }
+
+    template<typename T>
+    bool read(T &value)
+    {
+        return read(&value, sizeof(T));
+    }
+
+    bool read(void *dest, std::size_t size)
+    {
+        if (m_data.size() - m_offset < size)
+            return false;
+        std::memcpy(dest, m_data.data() + m_offset, size);
+        m_offset += size;
+        return true;
+    }
+
+private:
+    const std::vector<unsigned char> &m_data;
+    std::size_t m_offset = 0;
+};
+} // namespace
+
+bool BakedFonts::load(const std::string &path, TextureAtlas *textureAtlas)
+{
+    auto data = Util::readFile(path);
+    if (!data)
+        return false;
+
+    Reader reader(*data);
+
+    BakedFontFormat::Header header;
+    if (!reader.read(header) || header.magic != BakedFontFormat::Magic || header.version != BakedFontFormat::Version)
+    {
+        log("Invalid baked font file %s\n", path.c_str());
+        return false;
+    }
+
+    std::vector<int> pageLayers;
+    for (int i = 0; i < header.pageCount; ++i)
+    {
+        Pixmap page(header.pageWidth, header.pageHeight, PixelType::Grayscale);
+        if (!reader.read(page.pixels.data(), page.pixels.size()))
+        {
+            log("Truncated baked font file %s\n", path.c_str());
+            return false;
+        }
+        const auto layer = textureAtlas->addPage(std::move(page));
+        if (!layer)
+            return false;
+        pageLayers.push_back(*layer);
+    }
+
+    for (int i = 0; i < header.fontCount; ++i)
+    {
+        BakedFontFormat::Font bakedFont;
+        if (!reader.read(bakedFont))
+        {
+            log("Truncated baked font file %s\n", path.c_str());
+            return false;
+        }
+
+        auto &font = m_fonts.emplace_back();
+        font.name.assign(bakedFont.name, strnlen(bakedFont.name, BakedFontFormat::MaxFontNameLength));
+        font.pixelHeight = bakedFont.pixelHeight;
+        font.distanceField = bakedFont.distanceField != 0;
+
+        font.glyphs.reserve(bakedFont.glyphCount);
+        for (int j = 0; j < bakedFont.glyphCount; ++j)
+        {
+            BakedFontFormat::Glyph bakedGlyph;
+            if (!reader.read(bakedGlyph) || bakedGlyph.page < 0 || bakedGlyph.page >= header.pageCount)
+            {
+                log("Invalid glyph in baked font file %s\n", path.c_str());
+                return false;
+            }
+
+            const auto &bb = bakedGlyph.boundingBox;
+            const auto &tc = bakedGlyph.textureCoords;
+
+            PackedPixmap pixmap;
+            pixmap.width = bakedGlyph.width;
+            pixmap.height = bakedGlyph.height;
+            pixmap.textureCoords = BoxF{{tc[0], tc[1]}, {tc[2], tc[3]}};
+            pixmap.texture = textureAtlas->texture();
+            pixmap.textureLayer = pageLayers[bakedGlyph.page];
+
+            font.glyphs.push_back(
+                {bakedGlyph.codepoint, {BoxI{{bb[0], bb[1]}, {bb[2], bb[3]}}, bakedGlyph.advanceWidth, pixmap}});
+        }
+    }
+
+    return true;
+}
+
+const std::vector<BakedFonts::Glyph> *BakedFonts::glyphs(std::string_view name, int pixelHeight,
+                                                         bool distanceField) const
+{
+    auto it = std::find_if(m_fonts.begin(), m_fonts.end(), [name, pixelHeight, distanceField](const Font &font) {
+        return font.name == name && font.pixelHeight == pixelHeight && font.distanceField == distanceField;
+    });
+    return it != m_fonts.end() ? &it->glyphs : nullptr;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "fontcache.h"
+#include "noncopyable.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+class TextureAtlas;
+
+// Glyphs rasterized at build time by the fontbaker tool. Loading adds the baked pages to a texture atlas, and fonts
+// matching one of the baked ones can then be filled in without rasterizing anything.
+class BakedFonts : private NonCopyable
+{
+public:
+    bool load(const std::string &path, TextureAtlas *textureAtlas);
+
+    struct Glyph
+    {
+        int codepoint;
+        FontCache::Glyph glyph;
+    };
+    const std::vector<Glyph> *glyphs(std::string_view name, int pixelHeight, bool distanceField) const;
+
+private:
+    struct Font
+    {
+        std::string name;
+        int pixelHeight;
+        bool distanceField;
+        std::vector<Glyph> glyphs;
+    };
+    std::vector<Font> m_fonts;
+};
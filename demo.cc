@@ -1,5 +1,6 @@
 #include "demo.h"
 
+#include "formatbuffer.h"
 #include "mesh.h"
 #include "shadermanager.h"
 #include "uipainter.h"
@@ -12,12 +13,8 @@
 
 #include <random>
 #include <algorithm>
-#include <sstream>
-#include <iomanip>
 #include <optional>
 
-using namespace std::string_literals;
-
 namespace
 {
 constexpr const auto ShapeCount = 6;
@@ -219,6 +216,8 @@ Demo::Demo(int canvasWidth, int canvasHeight)
     , m_shakes(ShapeCount)
 {
     m_uiPainter->resize(canvasWidth, canvasHeight);
+    m_introLayer = m_uiPainter->createLayer();
+    m_scoreLayer = m_uiPainter->createLayer();
     initialize();
 }
 
@@ -349,7 +348,8 @@ void Demo::renderUI() const
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-    m_uiPainter->startPainting();
+    // everything is drawn at depth 0 anyway
+    m_uiPainter->startPainting(SpriteBatcher::SubmissionMode::Immediate);
 
     switch (m_state)
     {
@@ -374,29 +374,16 @@ void Demo::renderUI() const
 
 void Demo::renderTimer() const
 {
-    static const UIPainter::Font FontBig{FontName, 80};
-    static const UIPainter::Font FontSmall{FontName, 40};
+    static const UIPainter::Font FontBig{FontName, 80, true};
+    static const UIPainter::Font FontSmall{FontName, 40, true};
 
     const auto remaining = std::max(0, static_cast<int>((TotalPlayTime - m_playTime) * 1000));
-    const auto bigText = [remaining] {
-        std::stringstream ss;
-        ss.fill('0');
-        ss.width(2);
-        ss << remaining / 1000 / 60;
-        ss << ':';
-        ss.fill('0');
-        ss.width(2);
-        ss << (remaining / 1000) % 60;
-        return ss.str();
-    }();
-    const auto smallText = [remaining] {
-        std::stringstream ss;
-        ss << '.';
-        ss.fill('0');
-        ss.width(3);
-        ss << remaining % 1000;
-        return ss.str();
-    }();
+
+    FormatBuffer bigText;
+    bigText.append(remaining / 1000 / 60, 2).append(':').append((remaining / 1000) % 60, 2);
+
+    FormatBuffer smallText;
+    smallText.append('.').append(remaining % 1000, 3);
 
     const auto alpha = [this] {
         if (m_state == State::Result)
@@ -404,41 +391,49 @@ void Demo::renderTimer() const
         return 1.0f;
     }();
 
+    // the two parts are centered together, meeting at the decimal point
     m_uiPainter->setFont(FontBig);
-    const auto bigAdvance = m_uiPainter->horizontalAdvance(bigText);
+    const auto bigAdvance = m_uiPainter->horizontalAdvance(bigText.view());
 
     m_uiPainter->setFont(FontSmall);
-    const auto smallAdvance = m_uiPainter->horizontalAdvance(smallText);
+    const auto smallAdvance = m_uiPainter->horizontalAdvance(smallText.view());
 
-    const auto totalAdvance = bigAdvance + smallAdvance;
+    const auto textPos = glm::vec2(0.5f * (bigAdvance - smallAdvance), -0.5 * m_canvasHeight + 50);
 
-    const auto textPos = glm::vec2(-0.5 * totalAdvance, -0.5 * m_canvasHeight + 50);
+    m_uiPainter->drawText(textPos, glm::vec4(0, 0, 0, alpha), 0, smallText.view(), UIPainter::HorizontalAlign::Left);
 
     m_uiPainter->setFont(FontBig);
-    m_uiPainter->drawText(textPos, glm::vec4(0, 0, 0, alpha), 0, bigText);
-
-    m_uiPainter->setFont(FontSmall);
-    m_uiPainter->drawText(textPos + glm::vec2(bigAdvance, 0), glm::vec4(0, 0, 0, alpha), 0, smallText);
+    m_uiPainter->drawText(textPos, glm::vec4(0, 0, 0, alpha), 0, bigText.view(), UIPainter::HorizontalAlign::Right);
 }
 
 void Demo::renderIntro() const
 {
-    static const UIPainter::Font FontBig{FontName, 60};
-    static const UIPainter::Font FontSmall{FontName, 40};
+    static const UIPainter::Font FontBig{FontName, 60, true};
+    static const UIPainter::Font FontSmall{FontName, 40, true};
 
-    const auto color = glm::vec4(0, 0, 0, 1);
+    if (!m_introLayerRecorded)
+    {
+        const auto color = glm::vec4(0, 0, 0, 1);
 
-    m_uiPainter->setFont(FontBig);
-    drawCenteredText(glm::vec2(0, -40), color, "SELECT THE MATCHING PAIR"s);
+        m_uiPainter->startLayer(m_introLayer);
 
-    m_uiPainter->setFont(FontSmall);
-    drawCenteredText(glm::vec2(0, 200), color, "TAP TO START"s);
+        m_uiPainter->setFont(FontBig);
+        drawCenteredText(glm::vec2(0, -40), color, "SELECT THE MATCHING PAIR");
+
+        m_uiPainter->setFont(FontSmall);
+        drawCenteredText(glm::vec2(0, 200), color, "TAP TO START");
+
+        m_uiPainter->finishLayer();
+        m_introLayerRecorded = true;
+    }
+
+    m_uiPainter->drawLayer(m_introLayer, glm::vec4(1), 0);
 }
 
 void Demo::renderScore() const
 {
-    static const UIPainter::Font FontBig{FontName, 60};
-    static const UIPainter::Font FontSmall{FontName, 40};
+    static const UIPainter::Font FontBig{FontName, 60, true};
+    static const UIPainter::Font FontSmall{FontName, 40, true};
 
     const auto alpha = [this] {
         constexpr auto StartTime = 2.0f;
@@ -447,39 +442,41 @@ void Demo::renderScore() const
             return 0.0f;
         return std::min(1.0f, (m_stateTime - StartTime) / FadeInTime);
     }();
-    const auto color = glm::vec4(0, 0, 0, alpha);
 
-    m_uiPainter->setFont(FontBig);
+    // the text only changes with the score, so it's recorded once and faded in with the layer color
+    const auto content = std::make_pair(m_score, m_attempts);
+    if (m_scoreLayerContent != content)
+    {
+        const auto color = glm::vec4(0, 0, 0, 1);
 
-    const auto scoreText = [this] {
-        std::stringstream ss;
-        ss << m_score << " SHAPES ROTATED";
-        return ss.str();
-    }();
-    drawCenteredText(glm::vec2(0, -40), color, scoreText);
+        m_uiPainter->startLayer(m_scoreLayer);
 
-    if (m_score > 0)
-    {
-        const auto accuracyText = [this] {
-            std::stringstream ss;
-            ss << "ACCURACY: ";
-            ss << std::fixed;
-            ss << std::setprecision(2);
-            ss << m_score * 100.0f / m_attempts;
-            ss << "%";
-            return ss.str();
-        }();
-        drawCenteredText(glm::vec2(0, 20), color, accuracyText);
+        m_uiPainter->setFont(FontBig);
+
+        FormatBuffer text;
+        text.append(m_score).append(" SHAPES ROTATED");
+        drawCenteredText(glm::vec2(0, -40), color, text.view());
+
+        if (m_score > 0)
+        {
+            text.clear();
+            text.append("ACCURACY: ").append(m_score * 100.0f / m_attempts, 2).append('%');
+            drawCenteredText(glm::vec2(0, 20), color, text.view());
+        }
+
+        m_uiPainter->setFont(FontSmall);
+        drawCenteredText(glm::vec2(0, 200), color, "TAP TO RETRY");
+
+        m_uiPainter->finishLayer();
+        m_scoreLayerContent = content;
     }
 
-    m_uiPainter->setFont(FontSmall);
-    drawCenteredText(glm::vec2(0, 200), color, "TAP TO RETRY"s);
+    m_uiPainter->drawLayer(m_scoreLayer, glm::vec4(1, 1, 1, alpha), 0);
 }
 
-void Demo::drawCenteredText(const glm::vec2 &pos, const glm::vec4 &color, const std::string &text) const
+void Demo::drawCenteredText(const glm::vec2 &pos, const glm::vec4 &color, std::string_view text) const
 {
-    const auto advance = m_uiPainter->horizontalAdvance(text);
-    m_uiPainter->drawText(pos - glm::vec2(0.5f * advance, 0.0f), color, 0, text);
+    m_uiPainter->drawText(pos, color, 0, text, UIPainter::HorizontalAlign::Center);
 }
 
 void Demo::update(float elapsed)
@@ -8,6 +8,8 @@
 #include <glm/gtc/quaternion.hpp>
 
 #include <memory>
+#include <optional>
+#include <string_view>
 #include <vector>
 
 class Mesh;
@@ -63,7 +65,7 @@ private:
     void renderTimer() const;
     void renderScore() const;
     void renderIntro() const;
-    void drawCenteredText(const glm::vec2 &pos, const glm::vec4 &color, const std::string &text) const;
+    void drawCenteredText(const glm::vec2 &pos, const glm::vec4 &color, std::string_view text) const;
     void toggleShapeSelection(int shapeIndex);
 
     int m_canvasWidth;
@@ -80,4 +82,8 @@ private:
     int m_score = 0;
     int m_attempts = 0;
     std::vector<Shake> m_shakes;
+    int m_introLayer;
+    int m_scoreLayer;
+    mutable bool m_introLayerRecorded = false;
+    mutable std::optional<std::pair<int, int>> m_scoreLayerContent; // score and attempts the layer was recorded with
 };
@@ -1,92 +1,204 @@
 #include "fontcache.h"
 
-#include "ioutil.h"
+#include "fontface.h"
+#include "glyphrasterizer.h"
+#include "glyphrasterizerthread.h"
 #include "pixmap.h"
 #include "log.h"
 
+#include <algorithm>
+#include <cstdint>
+
 FontCache::FontCache(TextureAtlas *textureAtlas)
     : m_textureAtlas(textureAtlas)
 {
+    m_directGlyphIndices.fill(UnknownGlyph);
 }
 
 FontCache::~FontCache() = default;
 
-bool FontCache::load(const std::string &ttfPath, int pixelHeight)
+bool FontCache::load(std::shared_ptr<FontFace> face, int pixelHeight, bool distanceField)
 {
-    auto buffer = Util::readFile(ttfPath);
-    if (!buffer)
+    if (!face)
         return false;
 
-    m_ttfBuffer = std::move(*buffer);
+    m_face = std::move(face);
+    const auto *font = m_face->fontInfo();
 
-    int result = stbtt_InitFont(&m_font, m_ttfBuffer.data(), stbtt_GetFontOffsetForIndex(m_ttfBuffer.data(), 0));
-    if (result == 0)
-    {
-        return false;
-    }
-
-    m_scale = stbtt_ScaleForPixelHeight(&m_font, pixelHeight);
+    m_scale = stbtt_ScaleForPixelHeight(font, pixelHeight);
 
     int ascent;
     int descent;
     int lineGap;
-    stbtt_GetFontVMetrics(&m_font, &ascent, &descent, &lineGap);
+    stbtt_GetFontVMetrics(font, &ascent, &descent, &lineGap);
     m_ascent = m_scale * ascent;
     m_descent = m_scale * descent;
     m_lineGap = m_scale * lineGap;
 
     m_pixelHeight = pixelHeight;
+    m_distanceField = distanceField;
 
     return true;
 }
 
+float FontCache::kerning(int first, int second)
+{
+    if (!m_face->hasKerning() || first <= ' ' || second <= ' ')
+        return 0.0f;
+    return m_scale * m_face->kerning(first, second);
+}
+
 const FontCache::Glyph *FontCache::getGlyph(int codepoint)
 {
-    auto it = m_glyphs.find(codepoint);
-    if (it == m_glyphs.end())
-        it = m_glyphs.insert(it, {codepoint, initializeGlyph(codepoint)});
-    return it->second.get();
+    auto &slotIndex = glyphIndex(codepoint);
+    if (slotIndex == UnknownGlyph)
+        slotIndex = m_rasterizerThread ? initializePendingGlyph(codepoint) : initializeGlyph(codepoint);
+    auto index = slotIndex;
+    if (!m_rasterizerThread && index >= 0 && m_glyphs[index].pending)
+    {
+        // queued earlier but needed right away, the rasterizer thread's result is then ignored by finishGlyph()
+        BoxI boundingBox;
+        const auto pixmap = rasterizeGlyph(m_face->fontInfo(), m_scale, codepoint, m_distanceField, boundingBox);
+        finishGlyph(codepoint, pixmap, boundingBox);
+        // look it up again, slotIndex may be stale and the glyph may not have fit in the atlas
+        index = glyphIndex(codepoint);
+    }
+    return index != MissingGlyph ? &m_glyphs[index] : nullptr;
+}
+
+void FontCache::setRasterizerThread(GlyphRasterizerThread *rasterizerThread)
+{
+    m_rasterizerThread = rasterizerThread;
 }
 
-std::unique_ptr<FontCache::Glyph> FontCache::initializeGlyph(int codepoint)
+void FontCache::finishGlyph(int codepoint, const Pixmap &pixmap, const BoxI &boundingBox)
 {
-    auto pm = m_textureAtlas->addPixmap(getCodepointPixmap(codepoint));
+    auto &index = glyphIndex(codepoint);
+    if (index < 0 || !m_glyphs[index].pending)
+        return;
+
+    auto pm = addToAtlas(codepoint, pixmap, boundingBox);
     if (!pm)
     {
-        log("Couldn't fit glyph %d in texture atlas\n", codepoint);
-        return {};
+        index = MissingGlyph;
+        return;
+    }
+
+    auto &glyph = m_glyphs[index];
+    glyph.boundingBox = boundingBox;
+    glyph.pixmap = *pm;
+    glyph.pending = false;
+}
+
+void FontCache::addGlyph(int codepoint, const Glyph &glyph)
+{
+    auto &index = glyphIndex(codepoint);
+    if (index != UnknownGlyph)
+        return;
+    m_glyphs.push_back(glyph);
+    index = m_glyphs.size() - 1;
+}
+
+int &FontCache::glyphIndex(int codepoint)
+{
+    if (static_cast<unsigned>(codepoint) < DirectGlyphCount)
+        return m_directGlyphIndices[codepoint];
+
+    if (m_glyphSlots.empty())
+        growGlyphSlots();
+
+    auto *slot = findGlyphSlot(codepoint);
+    if (slot->index == UnknownGlyph)
+    {
+        // keep the table at most half full, only checked when claiming a slot so lookups never move it
+        if (2 * (m_glyphSlotCount + 1) > static_cast<int>(m_glyphSlots.size()))
+        {
+            growGlyphSlots();
+            slot = findGlyphSlot(codepoint);
+        }
+        // claim it, the caller fills in the index
+        slot->codepoint = codepoint;
+        ++m_glyphSlotCount;
     }
+    return slot->index;
+}
+
+FontCache::GlyphSlot *FontCache::findGlyphSlot(int codepoint)
+{
+    // the slot holding codepoint, or the free slot where it goes
+    const auto mask = m_glyphSlots.size() - 1;
+    for (auto i = (static_cast<std::uint32_t>(codepoint) * 0x9e3779b1u) & mask;; i = (i + 1) & mask)
+    {
+        auto &slot = m_glyphSlots[i];
+        if (slot.index == UnknownGlyph || slot.codepoint == codepoint)
+            return &slot;
+    }
+}
 
+void FontCache::growGlyphSlots()
+{
+    std::vector<GlyphSlot> slots(std::max<std::size_t>(2 * m_glyphSlots.size(), 64));
+    const auto mask = slots.size() - 1;
+    m_glyphSlotCount = 0;
+    for (const auto &slot : m_glyphSlots)
+    {
+        if (slot.index == UnknownGlyph)
+            continue;
+        auto i = (static_cast<std::uint32_t>(slot.codepoint) * 0x9e3779b1u) & mask;
+        while (slots[i].index != UnknownGlyph)
+            i = (i + 1) & mask;
+        slots[i] = slot;
+        ++m_glyphSlotCount;
+    }
+    m_glyphSlots.swap(slots);
+}
+
+int FontCache::initializeGlyph(int codepoint)
+{
+    BoxI boundingBox;
+    const auto pixmap = rasterizeGlyph(m_face->fontInfo(), m_scale, codepoint, m_distanceField, boundingBox);
+    auto pm = addToAtlas(codepoint, pixmap, boundingBox);
+    if (!pm)
+        return MissingGlyph;
+
+    int advanceWidth, leftSideBearing;
+    stbtt_GetCodepointHMetrics(m_face->fontInfo(), codepoint, &advanceWidth, &leftSideBearing);
+
+    auto &glyph = m_glyphs.emplace_back();
+    glyph.boundingBox = boundingBox;
+    glyph.advanceWidth = m_scale * advanceWidth;
+    glyph.pixmap = *pm;
+    return m_glyphs.size() - 1;
+}
+
+int FontCache::initializePendingGlyph(int codepoint)
+{
+    // the advance is cheap to get, so text can be laid out before the glyph is ready
     int advanceWidth, leftSideBearing;
-    stbtt_GetCodepointHMetrics(&m_font, codepoint, &advanceWidth, &leftSideBearing);
+    stbtt_GetCodepointHMetrics(m_face->fontInfo(), codepoint, &advanceWidth, &leftSideBearing);
 
-    int ix0, iy0, ix1, iy1;
-    stbtt_GetCodepointBitmapBox(&m_font, codepoint, m_scale, m_scale, &ix0, &iy0, &ix1, &iy1);
+    auto &glyph = m_glyphs.emplace_back();
+    glyph.boundingBox = BoxI{};
+    glyph.advanceWidth = m_scale * advanceWidth;
+    glyph.pixmap = PackedPixmap{};
+    glyph.pending = true;
 
-    assert(pm->width == ix1 - ix0);
-    assert(pm->height == iy1 - iy0);
+    m_rasterizerThread->enqueue(this, m_face->fontInfo(), m_scale, codepoint, m_distanceField);
 
-    auto glyph = std::make_unique<Glyph>();
-    glyph->boundingBox = BoxI{{ix0, iy0}, {ix1, iy1}};
-    glyph->advanceWidth = m_scale * advanceWidth;
-    glyph->pixmap = *pm;
-    return glyph;
+    return m_glyphs.size() - 1;
 }
 
-Pixmap FontCache::getCodepointPixmap(int codepoint) const
+std::optional<PackedPixmap> FontCache::addToAtlas(int codepoint, const Pixmap &pixmap, const BoxI &boundingBox)
 {
-    int ix0, iy0, ix1, iy1;
-    stbtt_GetCodepointBitmapBox(&m_font, codepoint, m_scale, m_scale, &ix0, &iy0, &ix1, &iy1);
-
-    const auto width = ix1 - ix0;
-    const auto height = iy1 - iy0;
-
-    Pixmap pm;
-    pm.width = width;
-    pm.height = height;
-    pm.pixelType = PixelType::Grayscale;
-    pm.pixels.resize(width * height);
-    stbtt_MakeCodepointBitmap(&m_font, pm.pixels.data(), width, height, width, m_scale, m_scale, codepoint);
+    auto pm = m_textureAtlas->addPixmap(pixmap);
+    if (!pm)
+    {
+        log("Couldn't fit glyph %d in texture atlas\n", codepoint);
+        return std::nullopt;
+    }
+
+    assert(pm->width == boundingBox.width());
+    assert(pm->height == boundingBox.height());
 
     return pm;
 }
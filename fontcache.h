@@ -4,14 +4,16 @@
 #include "util.h"
 
 #include <glm/glm.hpp>
-#include <stb_truetype.h>
 
+#include <array>
+#include <memory>
 #include <optional>
 #include <string>
-#include <unordered_map>
-#include <memory>
+#include <vector>
 
 struct Pixmap;
+class FontFace;
+class GlyphRasterizerThread;
 
 class FontCache
 {
@@ -19,30 +21,70 @@ public:
     explicit FontCache(TextureAtlas *textureAtlas);
     ~FontCache();
 
-    bool load(const std::string &ttfPath, int pixelHeight);
+    // Distance field fonts rasterize their glyphs as signed distance fields, meant to be drawn at any size with the
+    // distance field text programs. pixelHeight should then be DistanceFieldPixelHeight, which glyph metrics refer to.
+    bool load(std::shared_ptr<FontFace> face, int pixelHeight, bool distanceField = false);
+    bool isDistanceField() const { return m_distanceField; }
+
+    static constexpr int DistanceFieldPixelHeight = 48;
 
     struct Glyph
     {
         BoxI boundingBox;
         float advanceWidth;
         PackedPixmap pixmap;
+        bool pending = false; // still being rasterized, only advanceWidth is valid
     };
+    // The returned pointer is only valid until the next getGlyph() call, which may add glyphs.
     const Glyph *getGlyph(int codepoint);
 
+    // Adds a glyph that was rasterized ahead of time, see BakedFonts. Ignored if the codepoint is already cached.
+    void addGlyph(int codepoint, const Glyph &glyph);
+
+    // With a rasterizer thread, getGlyph() returns pending placeholders for new glyphs instead of rasterizing them
+    // right away, and the rasterizer later completes them through finishGlyph(). Without one (it can be unset again),
+    // getGlyph() also finishes pending glyphs on the spot.
+    void setRasterizerThread(GlyphRasterizerThread *rasterizerThread);
+    void finishGlyph(int codepoint, const Pixmap &pixmap, const BoxI &boundingBox);
+
+    // Offset to add to the pen position between two consecutive codepoints. Pairs involving spaces or control
+    // characters are never kerned, so text can be broken at spaces without changing the width of the pieces.
+    float kerning(int first, int second);
+
     int pixelHeight() const { return m_pixelHeight; }
     float ascent() const { return m_ascent; }
     float descent() const { return m_descent; }
     float lineGap() const { return m_lineGap; }
 
 private:
-    std::unique_ptr<Glyph> initializeGlyph(int codepoint);
-    Pixmap getCodepointPixmap(int codepoint) const;
+    int initializeGlyph(int codepoint);
+    int initializePendingGlyph(int codepoint);
+    std::optional<PackedPixmap> addToAtlas(int codepoint, const Pixmap &pixmap, const BoxI &boundingBox);
+
+    // index into m_glyphs, or one of these
+    static constexpr int UnknownGlyph = -1;
+    static constexpr int MissingGlyph = -2; // couldn't be added to the atlas
+
+    struct GlyphSlot
+    {
+        int codepoint;
+        int index = UnknownGlyph; // free while UnknownGlyph
+    };
+    int &glyphIndex(int codepoint);
+    GlyphSlot *findGlyphSlot(int codepoint);
+    void growGlyphSlots();
 
-    std::vector<unsigned char> m_ttfBuffer;
-    stbtt_fontinfo m_font;
+    std::shared_ptr<FontFace> m_face;
     TextureAtlas *m_textureAtlas;
-    std::unordered_map<int, std::unique_ptr<Glyph>> m_glyphs;
+    GlyphRasterizerThread *m_rasterizerThread = nullptr;
+    std::vector<Glyph> m_glyphs;
+    // Latin-1 glyphs are looked up directly, anything else through an open addressing table with linear probing
+    static constexpr int DirectGlyphCount = 256;
+    std::array<int, DirectGlyphCount> m_directGlyphIndices;
+    std::vector<GlyphSlot> m_glyphSlots;
+    int m_glyphSlotCount = 0; // used slots
     int m_pixelHeight;
+    bool m_distanceField = false;
     float m_scale = 0.0f;
     float m_ascent;
     float m_descent;
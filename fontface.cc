@@ -0,0 +1,52 @@
+#include "fontface.h"
+
+#include "ioutil.h"
+
+bool FontFace::load(const std::string &ttfPath)
+{
+    auto buffer = Util::readFile(ttfPath);
+    if (!buffer)
+        return false;
+
+    m_ttfBuffer = std::move(*buffer);
+
+    int result = stbtt_InitFont(&m_font, m_ttfBuffer.data(), stbtt_GetFontOffsetForIndex(m_ttfBuffer.data(), 0));
+    if (result == 0)
+    {
+        return false;
+    }
+
+    m_hasKerning = m_font.kern != 0 || m_font.gpos != 0;
+    m_kerningTable.assign(KerningTableSize * KerningTableSize, 0);
+    m_kerningPairs.clear();
+    if (m_hasKerning)
+    {
+        for (int i = 0; i < KerningTableSize; ++i)
+        {
+            for (int j = 0; j < KerningTableSize; ++j)
+            {
+                m_kerningTable[i * KerningTableSize + j] =
+                    stbtt_GetCodepointKernAdvance(&m_font, KerningTableFirst + i, KerningTableFirst + j);
+            }
+        }
+    }
+
+    return true;
+}
+
+int FontFace::kerning(int first, int second)
+{
+    if (!m_hasKerning)
+        return 0;
+
+    const auto row = static_cast<unsigned>(first - KerningTableFirst);
+    const auto column = static_cast<unsigned>(second - KerningTableFirst);
+    if (row < KerningTableSize && column < KerningTableSize)
+        return m_kerningTable[row * KerningTableSize + column];
+
+    const auto key = (static_cast<std::uint64_t>(first) << 32) | static_cast<std::uint32_t>(second);
+    auto it = m_kerningPairs.find(key);
+    if (it == m_kerningPairs.end())
+        it = m_kerningPairs.emplace(key, stbtt_GetCodepointKernAdvance(&m_font, first, second)).first;
+    return it->second;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <stb_truetype.h>
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// A parsed TrueType file, shared by the FontCache of every size drawn from it.
+class FontFace : private NonCopyable
+{
+public:
+    bool load(const std::string &ttfPath);
+
+    const stbtt_fontinfo *fontInfo() const { return &m_font; }
+    bool hasKerning() const { return m_hasKerning; }
+
+    // in font units, see stbtt_GetCodepointKernAdvance()
+    int kerning(int first, int second);
+
+private:
+    std::vector<unsigned char> m_ttfBuffer;
+    stbtt_fontinfo m_font;
+    // kerning between printable ASCII characters is computed on load, other pairs are looked up once and remembered
+    static constexpr int KerningTableFirst = 0x21;
+    static constexpr int KerningTableSize = 0x7f - KerningTableFirst;
+    std::vector<int> m_kerningTable;
+    std::unordered_map<std::uint64_t, int> m_kerningPairs;
+    bool m_hasKerning = false;
+};
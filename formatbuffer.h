@@ -0,0 +1,57 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <string_view>
+
+// Fixed size text buffer for formatting numbers without heap allocations, e.g. for text that changes every frame.
+// Anything past the capacity is dropped.
+class FormatBuffer
+{
+public:
+    static constexpr std::size_t Capacity = 64;
+
+    FormatBuffer &append(std::string_view text)
+    {
+        const auto count = std::min(text.size(), Capacity - m_size);
+        std::copy_n(text.data(), count, m_data.data() + m_size);
+        m_size += count;
+        return *this;
+    }
+
+    FormatBuffer &append(char ch) { return append(std::string_view(&ch, 1)); }
+
+    // Pads with zeros to at least minDigits digits.
+    FormatBuffer &append(int value, int minDigits = 0)
+    {
+        std::array<char, 16> digits;
+        const auto magnitude = value < 0 ? -static_cast<long long>(value) : static_cast<long long>(value);
+        const auto end = std::to_chars(digits.data(), digits.data() + digits.size(), magnitude).ptr;
+        const auto digitCount = static_cast<int>(end - digits.data());
+        if (value < 0)
+            append('-');
+        for (int i = digitCount; i < minDigits; ++i)
+            append('0');
+        return append(std::string_view(digits.data(), digitCount));
+    }
+
+    // Fixed notation with the given number of decimals.
+    FormatBuffer &append(float value, int precision)
+    {
+        std::array<char, 64> digits;
+        const auto result =
+            std::to_chars(digits.data(), digits.data() + digits.size(), value, std::chars_format::fixed, precision);
+        if (result.ec == std::errc())
+            append(std::string_view(digits.data(), result.ptr - digits.data()));
+        return *this;
+    }
+
+    void clear() { m_size = 0; }
+    bool empty() const { return m_size == 0; }
+    std::string_view view() const { return std::string_view(m_data.data(), m_size); }
+
+private:
+    std::array<char, Capacity> m_data;
+    std::size_t m_size = 0;
+};
@@ -0,0 +1,58 @@
+#include "glyphrasterizer.h"
+
+#include <algorithm>
+
+namespace
+{
+// distance field glyphs extend this many pixels past their outline, with the outline itself at 128
+constexpr auto DistanceFieldPadding = 6;
+constexpr auto DistanceFieldOnEdgeValue = 128;
+constexpr auto DistanceFieldPixelDistanceScale = static_cast<float>(DistanceFieldOnEdgeValue) / DistanceFieldPadding;
+
+Pixmap codepointPixmap(const stbtt_fontinfo *font, float scale, int codepoint, BoxI &boundingBox)
+{
+    int ix0, iy0, ix1, iy1;
+    stbtt_GetCodepointBitmapBox(font, codepoint, scale, scale, &ix0, &iy0, &ix1, &iy1);
+    boundingBox = BoxI{{ix0, iy0}, {ix1, iy1}};
+
+    const auto width = ix1 - ix0;
+    const auto height = iy1 - iy0;
+
+    Pixmap pm;
+    pm.width = width;
+    pm.height = height;
+    pm.pixelType = PixelType::Grayscale;
+    pm.pixels.resize(width * height);
+    stbtt_MakeCodepointBitmap(font, pm.pixels.data(), width, height, width, scale, scale, codepoint);
+
+    return pm;
+}
+
+Pixmap codepointDistanceField(const stbtt_fontinfo *font, float scale, int codepoint, BoxI &boundingBox)
+{
+    int width, height, xOffset, yOffset;
+    auto *sdf = stbtt_GetCodepointSDF(font, scale, codepoint, DistanceFieldPadding, DistanceFieldOnEdgeValue,
+                                      DistanceFieldPixelDistanceScale, &width, &height, &xOffset, &yOffset);
+    if (!sdf)
+    {
+        // nothing to draw (e.g. a space)
+        boundingBox = BoxI{};
+        return Pixmap(0, 0, PixelType::Grayscale);
+    }
+
+    boundingBox = BoxI{{xOffset, yOffset}, {xOffset + width, yOffset + height}};
+
+    Pixmap pm(width, height, PixelType::Grayscale);
+    std::copy(sdf, sdf + width * height, pm.pixels.begin());
+    stbtt_FreeSDF(sdf, nullptr);
+
+    return pm;
+}
+
+} // namespace
+
+Pixmap rasterizeGlyph(const stbtt_fontinfo *font, float scale, int codepoint, bool distanceField, BoxI &boundingBox)
+{
+    return distanceField ? codepointDistanceField(font, scale, codepoint, boundingBox)
+                         : codepointPixmap(font, scale, codepoint, boundingBox);
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include "pixmap.h"
+#include "util.h"
+
+#include <stb_truetype.h>
+
+// Renders a glyph at the given scale into a grayscale pixmap, either as coverage or as a signed distance field (with
+// the outline at 128), and returns its bounding box relative to the pen position.
+Pixmap rasterizeGlyph(const stbtt_fontinfo *font, float scale, int codepoint, bool distanceField, BoxI &boundingBox);
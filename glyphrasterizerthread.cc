@@ -0,0 +1,73 @@
+#include "glyphrasterizerthread.h"
+
+#include "fontcache.h"
+#include "glyphrasterizer.h"
+
+#include <vector>
+
+GlyphRasterizerThread::GlyphRasterizerThread()
+    : m_thread(&GlyphRasterizerThread::run, this)
+{
+}
+
+GlyphRasterizerThread::~GlyphRasterizerThread()
+{
+    {
+        std::lock_guard lock(m_mutex);
+        m_done = true;
+    }
+    m_jobAvailable.notify_one();
+    m_thread.join();
+}
+
+void GlyphRasterizerThread::enqueue(FontCache *fontCache, const stbtt_fontinfo *font, float scale, int codepoint,
+                                    bool distanceField)
+{
+    {
+        std::lock_guard lock(m_mutex);
+        m_jobs.push_back({fontCache, font, scale, codepoint, distanceField});
+    }
+    m_jobAvailable.notify_one();
+}
+
+void GlyphRasterizerThread::processResults(int pixelBudget)
+{
+    std::vector<Result> results;
+    {
+        std::lock_guard lock(m_mutex);
+        int pixelCount = 0;
+        while (!m_results.empty() && (results.empty() || pixelCount < pixelBudget))
+        {
+            auto &result = m_results.front();
+            pixelCount += result.pixmap.width * result.pixmap.height;
+            results.push_back(std::move(result));
+            m_results.pop_front();
+        }
+    }
+
+    for (const auto &result : results)
+        result.fontCache->finishGlyph(result.codepoint, result.pixmap, result.boundingBox);
+}
+
+void GlyphRasterizerThread::run()
+{
+    for (;;)
+    {
+        Job job;
+        {
+            std::unique_lock lock(m_mutex);
+            m_jobAvailable.wait(lock, [this] { return m_done || !m_jobs.empty(); });
+            if (m_done)
+                return;
+            job = m_jobs.front();
+            m_jobs.pop_front();
+        }
+
+        // stb_truetype only reads the font info, so this can run alongside the main thread
+        Result result{job.fontCache, job.codepoint, {}, {}};
+        result.pixmap = rasterizeGlyph(job.font, job.scale, job.codepoint, job.distanceField, result.boundingBox);
+
+        std::lock_guard lock(m_mutex);
+        m_results.push_back(std::move(result));
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "pixmap.h"
+#include "util.h"
+
+#include <stb_truetype.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+class FontCache;
+
+// Rasterizes glyphs on a worker thread. Finished glyphs are handed back to their FontCache by processResults(), on
+// the thread that owns the caches, so the texture atlas is only touched from there.
+class GlyphRasterizerThread : private NonCopyable
+{
+public:
+    GlyphRasterizerThread();
+    ~GlyphRasterizerThread();
+
+    void enqueue(FontCache *fontCache, const stbtt_fontinfo *font, float scale, int codepoint, bool distanceField);
+
+    // Finishes glyphs until about pixelBudget pixels were added to the atlas (always at least one glyph, if any).
+    void processResults(int pixelBudget);
+
+private:
+    void run();
+
+    struct Job
+    {
+        FontCache *fontCache;
+        const stbtt_fontinfo *font;
+        float scale;
+        int codepoint;
+        bool distanceField;
+    };
+
+    struct Result
+    {
+        FontCache *fontCache;
+        int codepoint;
+        Pixmap pixmap;
+        BoxI boundingBox;
+    };
+
+    std::mutex m_mutex;
+    std::condition_variable m_jobAvailable;
+    std::deque<Job> m_jobs;
+    std::deque<Result> m_results;
+    bool m_done = false;
+    std::thread m_thread;
+};
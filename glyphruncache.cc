@@ -0,0 +1,94 @@
+#include "glyphruncache.h"
+
+#include "fontcache.h"
+#include "utf8.h"
+
+#include <type_traits>
+
+const GlyphRunCache::GlyphRun &GlyphRunCache::run(FontCache *font, std::string_view text)
+{
+    return findRun(font, text);
+}
+
+const GlyphRunCache::GlyphRun &GlyphRunCache::run(FontCache *font, std::u32string_view text)
+{
+    return findRun(font, text);
+}
+
+template<typename CharT>
+const GlyphRunCache::GlyphRun &GlyphRunCache::findRun(FontCache *font, std::basic_string_view<CharT> text)
+{
+    const auto key = std::string_view(reinterpret_cast<const char *>(text.data()), text.size() * sizeof(CharT));
+    const auto hash = std::hash<std::string_view>()(key);
+
+    ++m_clock;
+
+    auto *leastRecentlyUsed = &m_entries.front();
+    for (auto &entry : m_entries)
+    {
+        if (entry.hash == hash && entry.font == font && entry.charSize == sizeof(CharT) && entry.key == key)
+        {
+            entry.lastUsed = m_clock;
+            return entry.run;
+        }
+        if (entry.lastUsed < leastRecentlyUsed->lastUsed)
+            leastRecentlyUsed = &entry;
+    }
+
+    // lay the text out into the least recently used entry, keeping its storage
+    auto &entry = *leastRecentlyUsed;
+    entry.font = font;
+    entry.hash = hash;
+    entry.charSize = sizeof(CharT);
+    entry.key.assign(key);
+    entry.lastUsed = m_clock;
+
+    auto &run = entry.run;
+    run.glyphs.clear();
+
+    glm::vec2 glyphPosition(0);
+    char32_t previous = 0;
+    bool complete = true;
+    const auto addGlyph = [font, &run, &glyphPosition, &previous, &complete](char32_t codepoint) {
+        glyphPosition.x += font->kerning(previous, codepoint);
+        previous = codepoint;
+
+        const auto glyph = font->getGlyph(codepoint);
+        if (!glyph)
+            return;
+        if (glyph->pending)
+        {
+            // still being rasterized, keep its space but draw nothing this frame
+            glyphPosition += glm::vec2(glyph->advanceWidth, 0);
+            complete = false;
+            return;
+        }
+        const auto p0 = glyphPosition + glm::vec2(glyph->boundingBox.min);
+        const auto p1 = p0 + glm::vec2(glyph->boundingBox.max - glyph->boundingBox.min);
+
+        const auto &pixmap = glyph->pixmap;
+        run.glyphs.push_back({{p0, p1}, pixmap.textureCoords, pixmap.texture, static_cast<float>(pixmap.textureLayer)});
+
+        glyphPosition += glm::vec2(glyph->advanceWidth, 0);
+    };
+
+    if constexpr (std::is_same_v<CharT, char>)
+    {
+        Util::forEachCodepoint(text, [&addGlyph](char32_t codepoint, std::size_t) { addGlyph(codepoint); });
+    }
+    else
+    {
+        for (auto ch : text)
+            addGlyph(ch);
+    }
+    run.advance = glyphPosition.x;
+
+    // don't keep runs with pending glyphs around, they need to be laid out again once the glyphs are ready
+    if (!complete)
+    {
+        entry.font = nullptr;
+        entry.lastUsed = 0;
+    }
+
+    return run;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "util.h"
+
+#include <array>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class AbstractTexture;
+class FontCache;
+
+// Remembers the laid out glyph quads of recently drawn strings, so that text repeated every frame skips the
+// per-character glyph lookups. Entries are recycled in least recently used order.
+class GlyphRunCache : private NonCopyable
+{
+public:
+    struct GlyphQuad
+    {
+        BoxF rect; // relative to the pen position at the start of the run
+        BoxF textureCoords;
+        const AbstractTexture *texture;
+        float textureLayer;
+    };
+
+    struct GlyphRun
+    {
+        std::vector<GlyphQuad> glyphs;
+        float advance = 0.0f;
+    };
+
+    // std::string_view text is decoded as UTF-8. The returned reference is valid until the next call.
+    const GlyphRun &run(FontCache *font, std::string_view text);
+    const GlyphRun &run(FontCache *font, std::u32string_view text);
+
+private:
+    template<typename CharT>
+    const GlyphRun &findRun(FontCache *font, std::basic_string_view<CharT> text);
+
+    static constexpr int Capacity = 64;
+
+    struct Entry
+    {
+        const FontCache *font = nullptr;
+        std::size_t hash = 0;
+        int charSize = 0;
+        std::string key; // raw bytes of the text
+        unsigned lastUsed = 0;
+        GlyphRun run;
+    };
+    std::array<Entry, Capacity> m_entries;
+    unsigned m_clock = 0;
+};
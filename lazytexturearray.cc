@@ -0,0 +1,52 @@
+#include "lazytexturearray.h"
+
+#include "pixmap.h"
+
+#include <algorithm>
+
+LazyTextureArray::LazyTextureArray(int width, int height, PixelType pixelType)
+    : m_width(width)
+    , m_height(height)
+    , m_pixelType(pixelType)
+{
+}
+
+LazyTextureArray::~LazyTextureArray() = default;
+
+int LazyTextureArray::addLayer(const Pixmap *pixmap)
+{
+    m_layers.push_back(pixmap);
+    m_dirty.push_back(true);
+    return m_layers.size() - 1;
+}
+
+int LazyTextureArray::layerCount() const
+{
+    return m_layers.size();
+}
+
+void LazyTextureArray::markDirty(int layer)
+{
+    m_dirty[layer] = true;
+}
+
+void LazyTextureArray::bind() const
+{
+    const int layerCount = m_layers.size();
+    if (!m_texture || m_texture->layerCount() < layerCount)
+    {
+        // grow geometrically so that new pages don't reallocate every time
+        const auto capacity = std::max(layerCount, m_texture ? 2 * m_texture->layerCount() : 1);
+        m_texture = std::make_unique<TextureArray>(m_width, m_height, capacity, m_pixelType);
+        std::fill(m_dirty.begin(), m_dirty.end(), true);
+    }
+    for (int layer = 0; layer < layerCount; ++layer)
+    {
+        if (m_dirty[layer])
+        {
+            m_texture->setLayerData(layer, m_layers[layer]->pixels.data());
+            m_dirty[layer] = false;
+        }
+    }
+    m_texture->bind();
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "abstracttexture.h"
+#include "pixeltype.h"
+#include "texturearray.h"
+
+#include <memory>
+#include <vector>
+
+struct Pixmap;
+
+// Texture array whose layers mirror a set of pixmaps, uploaded on bind. Adding layers reallocates the GL texture on
+// the next bind, but the object itself (and so any pointer to it) stays the same.
+class LazyTextureArray : public AbstractTexture
+{
+public:
+    LazyTextureArray(int width, int height, PixelType pixelType);
+    ~LazyTextureArray() override;
+
+    int addLayer(const Pixmap *pixmap);
+    int layerCount() const;
+
+    void markDirty(int layer);
+
+    void bind() const override;
+
+private:
+    int m_width;
+    int m_height;
+    PixelType m_pixelType;
+    std::vector<const Pixmap *> m_layers;
+    mutable std::vector<bool> m_dirty;
+    mutable std::unique_ptr<TextureArray> m_texture;
+};
@@ -0,0 +1,103 @@
+#include "paragraphlayout.h"
+
+#include "fontcache.h"
+#include "utf8.h"
+
+#include <algorithm>
+#include <optional>
+#include <utility>
+
+bool ParagraphLayout::update(FontCache *font, std::string_view text, float maxWidth)
+{
+    if (font != m_font || maxWidth != m_maxWidth)
+    {
+        m_font = font;
+        m_maxWidth = maxWidth;
+        m_text.assign(text);
+        breakRows(0);
+        return true;
+    }
+
+    const auto changed = std::mismatch(m_text.begin(), m_text.end(), text.begin(), text.end());
+    if (changed.first == m_text.end() && changed.second == text.end())
+        return false;
+    const auto changeOffset = static_cast<std::size_t>(changed.first - m_text.begin());
+
+    // The rows before the edited one can only change if the first word of the edited row now fits at the end of the
+    // previous one, so breaking resumes from the start of the previous row.
+    const auto editedRow = std::find_if(m_rows.begin(), m_rows.end(),
+                                        [changeOffset](const Row &row) { return changeOffset <= row.end; });
+    const auto firstRow = std::max<std::ptrdiff_t>(std::distance(m_rows.begin(), editedRow) - 1, 0);
+
+    m_text.assign(text);
+    breakRows(firstRow);
+    return true;
+}
+
+void ParagraphLayout::breakRows(std::size_t firstRow)
+{
+    const auto textStart = firstRow < m_rows.size() ? m_rows[firstRow].start : 0;
+    m_rows.erase(m_rows.begin() + std::min(firstRow, m_rows.size()), m_rows.end());
+    if (!m_font)
+        return;
+
+    // Rows always start after a space and kerning never applies around spaces, so breaking can resume at any row
+    // start with the pen at zero. Positions are byte offsets into m_text, paired with the pen position there.
+    using Position = std::pair<std::size_t, float>;
+
+    Position rowStart = {textStart, 0.0f};
+    std::optional<Position> lastBreak;
+
+    const auto spaceWidth = m_font->getGlyph(' ')->advanceWidth;
+
+    const auto addRow = [this](std::size_t start, float xStart, std::size_t end, float xEnd) {
+        m_rows.push_back({start, end, xEnd - xStart});
+    };
+
+    float lineWidth = 0.0f;
+    char32_t previous = 0;
+    Util::forEachCodepoint(std::string_view(m_text).substr(textStart), [&](char32_t ch, std::size_t offset) {
+        offset += textStart;
+
+        // never applies around spaces, so the break positions below aren't affected
+        lineWidth += m_font->kerning(previous, ch);
+        previous = ch;
+
+        if (ch == ' ')
+        {
+            if (lineWidth - rowStart.second > m_maxWidth)
+            {
+                if (lastBreak)
+                {
+                    addRow(rowStart.first, rowStart.second, lastBreak->first, lastBreak->second);
+                    rowStart = {lastBreak->first + 1, lastBreak->second + spaceWidth};
+                    lastBreak = {offset, lineWidth};
+                }
+                else
+                {
+                    addRow(rowStart.first, rowStart.second, offset, lineWidth);
+                    rowStart = {offset + 1, lineWidth + spaceWidth};
+                }
+            }
+            else
+            {
+                lastBreak = {offset, lineWidth};
+            }
+        }
+        if (const auto *glyph = m_font->getGlyph(ch))
+            lineWidth += glyph->advanceWidth;
+    });
+    if (rowStart.first != m_text.size())
+    {
+        if (lineWidth - rowStart.second > m_maxWidth && lastBreak)
+        {
+            addRow(rowStart.first, rowStart.second, lastBreak->first, lastBreak->second);
+            if (lastBreak->first + 1 != m_text.size())
+                addRow(lastBreak->first + 1, lastBreak->second + spaceWidth, m_text.size(), lineWidth);
+        }
+        else
+        {
+            addRow(rowStart.first, rowStart.second, m_text.size(), lineWidth);
+        }
+    }
+}
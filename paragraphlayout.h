@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+class FontCache;
+
+// Text broken into rows that fit a given width, at spaces. The rows are kept until the font, the width or the text
+// change, and when only the text changes, rows before the first edited character are reused and only the rest is
+// broken again. Widths are in font units, unscaled.
+class ParagraphLayout
+{
+public:
+    struct Row
+    {
+        std::size_t start; // byte offsets into the text
+        std::size_t end;
+        float width;
+    };
+
+    // Returns true if the rows had to be updated.
+    bool update(FontCache *font, std::string_view text, float maxWidth);
+
+    bool matches(const FontCache *font, std::string_view text, float maxWidth) const
+    {
+        return font == m_font && maxWidth == m_maxWidth && text == m_text;
+    }
+
+    const std::vector<Row> &rows() const { return m_rows; }
+    std::string_view rowText(const Row &row) const
+    {
+        return std::string_view(m_text).substr(row.start, row.end - row.start);
+    }
+
+private:
+    void breakRows(std::size_t firstRow);
+
+    FontCache *m_font = nullptr;
+    float m_maxWidth = 0.0f;
+    std::string m_text;
+    std::vector<Row> m_rows;
+};
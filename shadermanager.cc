@@ -40,10 +40,14 @@ std::unique_ptr<ShaderProgram> loadProgram(ShaderManager::Program id)
         const char *fragmentShader;
     };
     static const ProgramSource programSources[] = {
-        {"text.vert", "text.frag"},           // Text
-        {"shape.vert", "shape.frag"},         // Shape
-        {"circle.vert", "circle.frag"},       // Circle
-        {"thickline.vert", "thickline.frag"}, // ThickLine
+        {"text.vert", "text.frag"},                           // Text
+        {"shape.vert", "shape.frag"},                         // Shape
+        {"thickline.vert", "thickline.frag"},                 // ThickLine
+        {"text.vert", "text_sdf.frag"},                       // TextDistanceField
+        {"text_instanced.vert", "text.frag"},                 // TextInstanced
+        {"circle_instanced.vert", "circle.frag"},             // CircleInstanced
+        {"text_instanced.vert", "text_sdf.frag"},             // TextDistanceFieldInstanced
+        {"rounded_rect_instanced.vert", "rounded_rect.frag"}, // RoundedRectInstanced
     };
     static_assert(std::extent_v<decltype(programSources)> == ShaderManager::NumPrograms,
                   "expected number of programs to match");
@@ -65,6 +69,8 @@ void ShaderManager::useProgram(Program id)
         cachedProgram->program = loadProgram(id);
         auto &uniforms = cachedProgram->uniformLocations;
         std::fill(uniforms.begin(), uniforms.end(), -1);
+        if (cachedProgram->program)
+            bindUniformBlocks(*cachedProgram->program);
     }
     if (cachedProgram.get() == m_currentProgram)
     {
@@ -100,3 +106,21 @@ int ShaderManager::uniformLocation(Uniform id)
     }
     return location;
 }
+
+void ShaderManager::bindUniformBlocks(const ShaderProgram &program)
+{
+    static constexpr const char *uniformBlockNames[] = {
+        // clang-format off
+        "FrameUniforms",
+        // clang-format on
+    };
+    static_assert(std::extent_v<decltype(uniformBlockNames)> == NumUniformBlocks,
+                  "expected number of uniform blocks to match");
+
+    for (int block = 0; block < NumUniformBlocks; ++block)
+    {
+        const auto index = program.uniformBlockIndex(uniformBlockNames[block]);
+        if (index != -1)
+            program.setUniformBlockBinding(index, block);
+    }
+}
@@ -16,8 +16,13 @@ public:
     {
         Text,
         Shape,
-        Circle,
         ThickLine,
+        TextDistanceField,
+        // fed with SpriteBatcher::Instance records
+        TextInstanced,
+        CircleInstanced,
+        TextDistanceFieldInstanced,
+        RoundedRectInstanced,
         NumPrograms
     };
     void useProgram(Program program);
@@ -30,6 +35,14 @@ public:
         NumUniforms
     };
 
+    // Uniform blocks are bound to the binding point matching their enum value when a program is loaded, so callers
+    // only need to bind a buffer there.
+    enum UniformBlock
+    {
+        FrameUniforms, // mat4 mvp, vec4 colorMultiply (std140)
+        NumUniformBlocks
+    };
+
     template<typename T>
     void setUniform(Uniform uniform, T &&value)
     {
@@ -43,6 +56,7 @@ public:
 
 private:
     int uniformLocation(Uniform uniform);
+    void bindUniformBlocks(const ShaderProgram &program);
 
     struct CachedProgram
     {
@@ -91,6 +91,17 @@ int ShaderProgram::uniformLocation(std::string_view name) const
     return glGetUniformLocation(m_id, name.data());
 }
 
+int ShaderProgram::uniformBlockIndex(std::string_view name) const
+{
+    const auto index = glGetUniformBlockIndex(m_id, name.data());
+    return index == GL_INVALID_INDEX ? -1 : static_cast<int>(index);
+}
+
+void ShaderProgram::setUniformBlockBinding(int blockIndex, int binding) const
+{
+    glUniformBlockBinding(m_id, blockIndex, binding);
+}
+
 void ShaderProgram::setUniform(int location, int value) const
 {
     glUniform1i(location, value);
@@ -116,6 +127,11 @@ void ShaderProgram::setUniform(int location, const glm::vec4 &value) const
     glUniform4fv(location, 1, glm::value_ptr(value));
 }
 
+void ShaderProgram::setUniform(int location, const std::vector<int> &value) const
+{
+    glUniform1iv(location, value.size(), value.data());
+}
+
 void ShaderProgram::setUniform(int location, const std::vector<float> &value) const
 {
     glUniform1fv(location, value.size(), value.data());
@@ -23,6 +23,8 @@ public:
     void bind() const;
 
     int uniformLocation(std::string_view name) const;
+    int uniformBlockIndex(std::string_view name) const;
+    void setUniformBlockBinding(int blockIndex, int binding) const;
 
     void setUniform(int location, int v) const;
     void setUniform(int location, float v) const;
@@ -30,6 +32,7 @@ public:
     void setUniform(int location, const glm::vec3 &v) const;
     void setUniform(int location, const glm::vec4 &v) const;
 
+    void setUniform(int location, const std::vector<int> &v) const;
     void setUniform(int location, const std::vector<float> &v) const;
     void setUniform(int location, const std::vector<glm::vec2> &v) const;
     void setUniform(int location, const std::vector<glm::vec3> &v) const;
@@ -1,10 +1,32 @@
 #include "spritebatcher.h"
 #include "abstracttexture.h"
 #include "textureatlas.h"
+#include "log.h"
 
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <algorithm>
+#include <cassert>
+#include <limits>
+#include <numeric>
+
+namespace
+{
+template<typename T>
+void shrinkStorage(std::vector<T> &storage, std::size_t size)
+{
+    if (storage.capacity() <= size)
+        return;
+    std::vector<T> shrunk;
+    shrunk.reserve(size);
+    shrunk.assign(storage.begin(), storage.end());
+    storage.swap(shrunk);
+}
+
+// unit quad corners, expanded into each instance's rect in the vertex shader
+constexpr std::array<glm::vec2, 4> QuadCorners = {glm::vec2(0, 0), glm::vec2(1, 0), glm::vec2(0, 1), glm::vec2(1, 1)};
+
+} // namespace
 
 SpriteBatcher::SpriteBatcher(ShaderManager *shaderManager)
     : m_shaderManager(shaderManager)
@@ -37,9 +59,91 @@ ShaderManager::Program SpriteBatcher::batchProgram() const
     return m_batchProgram;
 }
 
-void SpriteBatcher::startBatch()
+void SpriteBatcher::setOverlapMerging(bool enabled)
+{
+    m_overlapMerging = enabled;
+}
+
+bool SpriteBatcher::overlapMerging() const
+{
+    return m_overlapMerging;
+}
+
+SpriteBatcher::Stats &SpriteBatcher::Stats::operator+=(const Stats &other)
+{
+    quads += other.quads;
+    drawCalls += other.drawCalls;
+    programSwitches += other.programSwitches;
+    textureBinds += other.textureBinds;
+    bufferOrphans += other.bufferOrphans;
+    uploadedBytes += other.uploadedBytes;
+    return *this;
+}
+
+const SpriteBatcher::Stats &SpriteBatcher::batchStats() const
+{
+    return m_batchStats;
+}
+
+const SpriteBatcher::Stats &SpriteBatcher::frameStats() const
+{
+    return m_frameStats;
+}
+
+void SpriteBatcher::endFrame()
+{
+    m_statsHistory[m_statsHistoryHead] = m_frameStats;
+    m_statsHistoryHead = (m_statsHistoryHead + 1) % StatsHistorySize;
+    m_statsHistoryCount = std::min(m_statsHistoryCount + 1, StatsHistorySize);
+    m_frameStats = {};
+}
+
+int SpriteBatcher::statsHistorySize() const
+{
+    return m_statsHistoryCount;
+}
+
+const SpriteBatcher::Stats &SpriteBatcher::frameStatsHistory(int framesAgo) const
+{
+    assert(framesAgo >= 0 && framesAgo < m_statsHistoryCount);
+    return m_statsHistory[(m_statsHistoryHead - 1 - framesAgo + StatsHistorySize) % StatsHistorySize];
+}
+
+void SpriteBatcher::startBatch(SubmissionMode mode)
+{
+    m_submissionMode = mode;
+    m_quadHighWaterMark = std::max(m_quadHighWaterMark, static_cast<int>(m_frameSprites.quads.size()));
+    m_frameSprites.clear();
+}
+
+void SpriteBatcher::reserve(int quadCount, int instanceCount)
 {
-    m_quadCount = 0;
+    quadCount = std::min(quadCount, MaxQuadsPerBatch);
+    instanceCount = std::min(instanceCount, MaxQuadsPerBatch - quadCount);
+    m_frameSprites.quads.reserve(quadCount + instanceCount);
+    m_frameSprites.quadVerts.reserve(quadCount);
+    m_frameSprites.instances.reserve(instanceCount);
+    m_sortedQuads.reserve(quadCount + instanceCount);
+}
+
+void SpriteBatcher::shrink()
+{
+    auto &sprites = m_frameSprites;
+    const auto quadCount = std::max(m_quadHighWaterMark, static_cast<int>(sprites.quads.size()));
+    shrinkStorage(sprites.quads, quadCount);
+    shrinkStorage(sprites.quadVerts, quadCount);
+    shrinkStorage(sprites.instances, quadCount);
+    shrinkStorage(sprites.layerDraws, quadCount);
+    m_sortedQuads.clear();
+    shrinkStorage(m_sortedQuads, quadCount);
+    m_batches.clear();
+    shrinkStorage(m_batches, 0);
+    m_quadHighWaterMark = sprites.quads.size();
+}
+
+int SpriteBatcher::capacity() const
+{
+    return m_frameSprites.quads.capacity();
 }
 
 void SpriteBatcher::addSprite(const PackedPixmap &pixmap, const glm::vec2 &topLeft, const glm::vec2 &bottomRight,
@@ -52,78 +156,216 @@ void SpriteBatcher::addSprite(const PackedPixmap &pixmap, const glm::vec2 &topLe
     const auto &t0 = textureCoords.min;
     const auto &t1 = textureCoords.max;
 
-    const auto verts = QuadVerts{{{{p0.x, p0.y}, {t0.x, t0.y}, fgColor, bgColor},
-                                  {{p1.x, p0.y}, {t1.x, t0.y}, fgColor, bgColor},
-                                  {{p1.x, p1.y}, {t1.x, t1.y}, fgColor, bgColor},
-                                  {{p0.x, p1.y}, {t0.x, t1.y}, fgColor, bgColor}}};
+    const auto layer = static_cast<float>(pixmap.textureLayer);
 
-    addSprite(pixmap.texture, verts, depth);
+    reserveQuads(pixmap.texture, 1, depth)[0] = QuadVerts{{{{p0.x, p0.y}, {t0.x, t0.y}, fgColor, bgColor, layer},
+                                                          {{p1.x, p0.y}, {t1.x, t0.y}, fgColor, bgColor, layer},
+                                                          {{p1.x, p1.y}, {t1.x, t1.y}, fgColor, bgColor, layer},
+                                                          {{p0.x, p1.y}, {t0.x, t1.y}, fgColor, bgColor, layer}}};
 }
 
 void SpriteBatcher::addSprite(const PackedPixmap &pixmap, const glm::vec2 &topLeft, const glm::vec2 &bottomRight,
                               const glm::vec4 &color, int depth)
 {
-    const auto &p0 = topLeft;
-    const auto &p1 = bottomRight;
+    addSprite(pixmap, topLeft, bottomRight, color, glm::vec4(0), depth);
+}
 
-    const auto &textureCoords = pixmap.textureCoords;
-    const auto &t0 = textureCoords.min;
-    const auto &t1 = textureCoords.max;
+int SpriteBatcher::makeRoomForSprites(int count)
+{
+    // layers are uploaded in one go when they're finished, so only the frame batch is bounded
+    if (m_sprites != &m_frameSprites)
+        return count;
+    if (m_frameSprites.quads.size() + count > MaxQuadsPerBatch)
+    {
+        renderBatch();
+        startBatch(m_submissionMode);
+    }
+    return std::min(count, MaxQuadsPerBatch);
+}
 
-    const auto verts = QuadVerts{{{{p0.x, p0.y}, {t0.x, t0.y}, color, {0, 0, 0, 0}},
-                                  {{p1.x, p0.y}, {t1.x, t0.y}, color, {0, 0, 0, 0}},
-                                  {{p1.x, p1.y}, {t1.x, t1.y}, color, {0, 0, 0, 0}},
-                                  {{p0.x, p1.y}, {t0.x, t1.y}, color, {0, 0, 0, 0}}}};
+void SpriteBatcher::addSprite(const AbstractTexture *texture, const QuadVerts &verts, int depth)
+{
+    reserveQuads(texture, 1, depth)[0] = verts;
+}
 
-    addSprite(pixmap.texture, verts, depth);
+void SpriteBatcher::addSprite(const AbstractTexture *texture, const Instance &instance, int depth)
+{
+    reserveInstances(texture, 1, depth)[0] = instance;
 }
 
-void SpriteBatcher::addSprite(const AbstractTexture *texture, const QuadVerts &verts, int depth)
+std::span<SpriteBatcher::QuadVerts> SpriteBatcher::reserveQuads(const AbstractTexture *texture, int count, int depth)
 {
-    if (m_quadCount == MaxQuadsPerBatch)
+    return reserveSprites(&SpriteList::quadVerts, QuadType::Verts, texture, count, depth);
+}
+
+std::span<SpriteBatcher::Instance> SpriteBatcher::reserveInstances(const AbstractTexture *texture, int count,
+                                                                   int depth)
+{
+    return reserveSprites(&SpriteList::instances, QuadType::Instance, texture, count, depth);
+}
+
+template<typename T>
+std::span<T> SpriteBatcher::reserveSprites(std::vector<T> SpriteList::*storage, QuadType type,
+                                           const AbstractTexture *texture, int count, int depth)
+{
+    count = makeRoomForSprites(count);
+    auto &sprites = *m_sprites;
+    auto &items = sprites.*storage;
+    const auto start = static_cast<int>(items.size());
+    for (int i = 0; i < count; ++i)
+        sprites.quads.push_back({texture, m_batchProgram, depth, type, start + i});
+    items.resize(start + count);
+    return std::span<T>(items).subspan(start);
+}
+
+void SpriteBatcher::discardSprites(int count)
+{
+    auto &sprites = *m_sprites;
+    count = std::min(count, static_cast<int>(sprites.quads.size()));
+    for (int i = 0; i < count; ++i)
     {
-        renderBatch();
-        startBatch();
+        switch (sprites.quads.back().type)
+        {
+        case QuadType::Verts:
+            sprites.quadVerts.pop_back();
+            break;
+        case QuadType::Instance:
+            sprites.instances.pop_back();
+            break;
+        case QuadType::Layer:
+            sprites.layerDraws.pop_back();
+            break;
+        }
+        sprites.quads.pop_back();
     }
+}
 
-    auto &quad = m_quads[m_quadCount++];
-    quad.texture = texture;
-    quad.program = m_batchProgram;
-    quad.verts = verts;
-    quad.depth = depth;
+SpriteBatcher::LayerHandle SpriteBatcher::createLayer()
+{
+    auto it = std::find(m_layers.begin(), m_layers.end(), nullptr);
+    if (it == m_layers.end())
+        it = m_layers.insert(it, nullptr);
+    auto layer = std::make_unique<Layer>();
+    glGenBuffers(1, &layer->vbo);
+    *it = std::move(layer);
+    return it - m_layers.begin();
 }
 
-void SpriteBatcher::renderBatch() const
+void SpriteBatcher::releaseLayer(LayerHandle layer)
 {
-    if (m_quadCount == 0)
+    if (layer < 0 || layer >= static_cast<int>(m_layers.size()) || !m_layers[layer])
         return;
+    assert(layer != m_recordingLayer);
+    glDeleteBuffers(1, &m_layers[layer]->vbo);
+    m_layers[layer].reset();
+}
 
-    static std::array<const Quad *, MaxQuadsPerBatch> sortedQuads;
-    const auto quadsEnd = m_quads.begin() + m_quadCount;
-    std::transform(m_quads.begin(), quadsEnd, sortedQuads.begin(), [](const Quad &quad) { return &quad; });
-    const auto sortedQuadsEnd = sortedQuads.begin() + m_quadCount;
-    std::stable_sort(sortedQuads.begin(), sortedQuadsEnd, [](const Quad *a, const Quad *b) {
-        return std::tie(a->depth, a->texture, a->program) < std::tie(b->depth, b->texture, b->program);
-    });
+void SpriteBatcher::startLayer(LayerHandle layer)
+{
+    if (m_recordingLayer != InvalidLayer)
+    {
+        log("Already recording a layer lol\n");
+        return;
+    }
+    if (layer < 0 || layer >= static_cast<int>(m_layers.size()) || !m_layers[layer])
+    {
+        log("Invalid layer %d\n", layer);
+        return;
+    }
+    m_recordingLayer = layer;
+    m_sprites = &m_layerSprites;
+}
 
-    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
-    glBindVertexArray(m_vao);
+void SpriteBatcher::finishLayer()
+{
+    if (m_recordingLayer == InvalidLayer)
+        return;
 
-    const AbstractTexture *currentTexture = nullptr;
-    std::optional<ShaderManager::Program> currentProgram = std::nullopt;
+    auto &layer = *m_layers[m_recordingLayer];
+    const auto &sprites = m_layerSprites;
+
+    sortQuads(sprites);
+    layer.batches.clear();
+    const auto bufferSize = layoutBatches(m_sortedQuads.cbegin(), m_sortedQuads.cend(), sprites, layer.batches);
 
-    auto batchStart = sortedQuads.begin();
-    while (batchStart != sortedQuadsEnd)
+    glBindBuffer(GL_ARRAY_BUFFER, layer.vbo);
+    glBufferData(GL_ARRAY_BUFFER, bufferSize * sizeof(GLfloat), nullptr, GL_STATIC_DRAW);
+    if (bufferSize > 0)
     {
-        const auto *batchTexture = (*batchStart)->texture;
-        const auto batchProgram = (*batchStart)->program;
-        const auto batchEnd =
-            std::find_if(batchStart + 1, sortedQuadsEnd, [batchTexture, batchProgram](const Quad *quad) {
-                return quad->texture != batchTexture || quad->program != batchProgram;
-            });
+        auto *data = reinterpret_cast<GLfloat *>(glMapBufferRange(GL_ARRAY_BUFFER, 0, bufferSize * sizeof(GLfloat),
+                                                                  GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+        writeBatches(data, m_sortedQuads.cbegin(), sprites, layer.batches);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+        m_frameStats.uploadedBytes += bufferSize * sizeof(GLfloat);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    m_layerSprites.clear();
+    m_sprites = &m_frameSprites;
+    m_recordingLayer = InvalidLayer;
+}
 
-        const auto quadCount = batchEnd - batchStart;
-        const auto bufferRangeSize = quadCount * GLQuadSize;
+void SpriteBatcher::drawLayer(LayerHandle layer, const glm::mat4 &transform, const glm::vec4 &color, int depth)
+{
+    if (m_recordingLayer != InvalidLayer)
+    {
+        log("Can't draw a layer into another layer lol\n");
+        return;
+    }
+    if (layer < 0 || layer >= static_cast<int>(m_layers.size()) || !m_layers[layer])
+        return;
+
+    makeRoomForSprites(1);
+    auto &sprites = m_frameSprites;
+    sprites.quads.push_back(
+        {nullptr, m_batchProgram, depth, QuadType::Layer, static_cast<int>(sprites.layerDraws.size())});
+    sprites.layerDraws.push_back({layer, transform, color});
+}
+
+void SpriteBatcher::renderBatch() const
+{
+    m_batchStats = {};
+
+    const auto &sprites = m_frameSprites;
+    if (sprites.quads.empty())
+        return;
+
+    m_batchStats.quads = sprites.quads.size();
+
+    int bufferRangeSize;
+    if (m_submissionMode == SubmissionMode::Sorted)
+    {
+        sortQuads(sprites);
+        bufferRangeSize = uploadBatches(m_sortedQuads.cbegin(), m_sortedQuads.cend(), sprites);
+    }
+    else
+    {
+        // already in drawing order, no need to sort or go through pointers
+        bufferRangeSize = uploadBatches(sprites.quads.cbegin(), sprites.quads.cend(), sprites);
+    }
+
+    // then issue one draw call per run
+    glBindBufferBase(GL_UNIFORM_BUFFER, ShaderManager::FrameUniforms, m_frameUniformsBuffer);
+    drawBatches(m_batches, m_vbo, m_bufferOffset, m_transformMatrix, glm::vec4(1));
+
+    m_bufferOffset += bufferRangeSize;
+    m_frameStats += m_batchStats;
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+template<typename QuadIterator>
+int SpriteBatcher::uploadBatches(QuadIterator quadsBegin, QuadIterator quadsEnd, const SpriteList &sprites) const
+{
+    const auto bufferRangeSize = layoutBatches(quadsBegin, quadsEnd, sprites, m_batches);
+
+    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+
+    if (bufferRangeSize > 0)
+    {
+        // the mapped range starts at a vertex boundary so that the batch offsets stay aligned
+        m_bufferOffset = (m_bufferOffset + GLVertexSize - 1) / GLVertexSize * GLVertexSize;
 
         if (!m_bufferAllocated || (m_bufferOffset + bufferRangeSize > BufferCapacity))
         {
@@ -131,106 +373,495 @@ void SpriteBatcher::renderBatch() const
             glBufferData(GL_ARRAY_BUFFER, BufferCapacity * sizeof(GLfloat), nullptr, GL_STREAM_DRAW);
             m_bufferOffset = 0;
             m_bufferAllocated = true;
+            ++m_batchStats.bufferOrphans;
         }
 
+        // write all the quads in a single pass
         auto *data = reinterpret_cast<GLfloat *>(glMapBufferRange(GL_ARRAY_BUFFER, m_bufferOffset * sizeof(GLfloat),
                                                                   bufferRangeSize * sizeof(GLfloat),
-                                                                  GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
-        for (auto it = batchStart; it != batchEnd; ++it)
-        {
-            auto *quadPtr = *it;
+                                                                  GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT));
+        writeBatches(data, quadsBegin, sprites, m_batches);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+        m_batchStats.uploadedBytes += bufferRangeSize * sizeof(GLfloat);
+    }
 
-            const auto &verts = quadPtr->verts;
+    return bufferRangeSize;
+}
 
-            const auto emitVertex = [&data, &verts](int index) {
-                const auto &v = verts[index];
-                *data++ = v.position.x;
-                *data++ = v.position.y;
+void SpriteBatcher::sortQuads(const SpriteList &sprites) const
+{
+    const auto &quads = sprites.quads;
+    auto &sortedQuads = m_sortedQuads;
+    sortedQuads.resize(quads.size());
+    std::transform(quads.begin(), quads.end(), sortedQuads.begin(), [](const Quad &quad) { return &quad; });
+    std::stable_sort(sortedQuads.begin(), sortedQuads.end(), [](const Quad *a, const Quad *b) {
+        return std::tie(a->depth, a->program, a->texture) < std::tie(b->depth, b->program, b->texture);
+    });
+    if (m_overlapMerging)
+        mergeQuads(sprites);
+}
 
-                *data++ = v.textureCoords.x;
-                *data++ = v.textureCoords.y;
+void SpriteBatcher::mergeQuads(const SpriteList &sprites) const
+{
+    // Greedily move each quad back to the latest run with the same state, unless it overlaps a run in between.
+    // Runs are kept as linked lists of indices into the depth-sorted quads, and flattened back in run order.
 
-                *data++ = v.fgColor.x;
-                *data++ = v.fgColor.y;
-                *data++ = v.fgColor.z;
-                *data++ = v.fgColor.w;
+    constexpr auto MaxLookback = 32;
 
-                *data++ = v.bgColor.x;
-                *data++ = v.bgColor.y;
-                *data++ = v.bgColor.z;
-                *data++ = v.bgColor.w;
-            };
+    const auto sameState = [](const Quad *a, const Quad *b) {
+        return a->type != QuadType::Layer && a->texture == b->texture && a->program == b->program &&
+               a->type == b->type;
+    };
+
+    auto &runs = m_mergeRuns;
+    auto &next = m_mergeNext;
+    runs.clear();
+    const auto quadCount = static_cast<int>(m_sortedQuads.size());
+    next.assign(quadCount, -1);
 
-            emitVertex(0);
-            emitVertex(1);
-            emitVertex(2);
+    for (int i = 0; i < quadCount; ++i)
+    {
+        const auto *quad = m_sortedQuads[i];
+        const auto bounds = quadBounds(sprites, *quad);
 
-            emitVertex(2);
-            emitVertex(3);
-            emitVertex(0);
+        auto target = runs.rend();
+        const auto lookbackEnd = runs.rbegin() + std::min<int>(runs.size(), MaxLookback);
+        for (auto it = runs.rbegin(); it != lookbackEnd; ++it)
+        {
+            if (sameState(it->quad, quad))
+            {
+                target = it;
+                break;
+            }
+            if (it->bounds.intersects(bounds))
+                break;
         }
-        glUnmapBuffer(GL_ARRAY_BUFFER);
 
-        if (currentTexture != batchTexture)
+        if (target == runs.rend())
+        {
+            runs.push_back({quad, bounds, i, i});
+        }
+        else
         {
-            currentTexture = batchTexture;
-            if (currentTexture)
-                currentTexture->bind();
+            next[target->tail] = i;
+            target->tail = i;
+            target->bounds |= bounds;
         }
+    }
+
+    if (static_cast<int>(runs.size()) == quadCount)
+        return;
 
-        if (currentProgram != batchProgram)
+    auto &mergedQuads = m_mergeScratch;
+    mergedQuads.clear();
+    for (const auto &run : runs)
+    {
+        for (int i = run.head; i != -1; i = next[i])
+            mergedQuads.push_back(m_sortedQuads[i]);
+    }
+    m_sortedQuads.swap(mergedQuads);
+}
+
+BoxF SpriteBatcher::quadBounds(const SpriteList &sprites, const Quad &quad) const
+{
+    const auto boundsOf = [](const auto &points) {
+        BoxF bounds{points[0], points[0]};
+        for (const auto &p : points)
+            bounds |= BoxF{p, p};
+        return bounds;
+    };
+
+    switch (quad.type)
+    {
+    case QuadType::Verts: {
+        const auto &verts = sprites.quadVerts[quad.index];
+        return boundsOf(std::array<glm::vec2, 4>{verts[0].position, verts[1].position, verts[2].position,
+                                                 verts[3].position});
+    }
+    case QuadType::Instance: {
+        const auto &instance = sprites.instances[quad.index];
+        const auto &rect = instance.rect;
+        const auto &t = instance.transform;
+        const auto transformed = [&t](float x, float y) { return t[0] * x + t[1] * y + t[2]; };
+        return boundsOf(std::array<glm::vec2, 4>{transformed(rect.min.x, rect.min.y),
+                                                 transformed(rect.max.x, rect.min.y),
+                                                 transformed(rect.max.x, rect.max.y),
+                                                 transformed(rect.min.x, rect.max.y)});
+    }
+    case QuadType::Layer:
+    default: {
+        // could be anywhere
+        constexpr auto Infinity = std::numeric_limits<float>::infinity();
+        return BoxF{glm::vec2(-Infinity), glm::vec2(Infinity)};
+    }
+    }
+}
+
+template<typename QuadIterator>
+int SpriteBatcher::layoutBatches(QuadIterator quadsBegin, QuadIterator quadsEnd, const SpriteList &sprites,
+                                 std::vector<Batch> &batches) const
+{
+    // split the quads into runs sharing program and vertex format, with up to MaxTextureSlots textures each,
+    // and lay them out in the buffer
+
+    batches.clear();
+    int bufferRangeSize = 0;
+
+    auto batchStart = quadsBegin;
+    while (batchStart != quadsEnd)
+    {
+        const auto &startQuad = quadRef(*batchStart);
+        const auto batchProgram = startQuad.program;
+        const auto batchType = startQuad.type;
+        const auto quadStart = static_cast<int>(batchStart - quadsBegin);
+
+        if (batchType == QuadType::Layer)
         {
-            currentProgram = batchProgram;
-            m_shaderManager->useProgram(batchProgram);
-            m_shaderManager->setUniform(ShaderManager::Uniform::ModelViewProjection, m_transformMatrix);
-            if (currentTexture)
-                m_shaderManager->setUniform(ShaderManager::Uniform::BaseColorTexture, 0);
+            // layers are drawn from their own buffer, one at a time
+            const auto *layerDraw = &sprites.layerDraws[startQuad.index];
+            batches.push_back({{}, 0, batchProgram, batchType, quadStart, 1, bufferRangeSize, layerDraw});
+            ++batchStart;
+            continue;
         }
 
-        glDrawArrays(GL_TRIANGLES, m_bufferOffset / GLVertexSize, quadCount * 6);
+        Batch batch{{}, 0, batchProgram, batchType, quadStart, 0, 0, nullptr};
+
+        auto batchEnd = batchStart;
+        for (; batchEnd != quadsEnd; ++batchEnd)
+        {
+            const auto &quad = quadRef(*batchEnd);
+            if (quad.program != batchProgram || quad.type != batchType)
+                break;
+            if (quad.texture && batch.textureSlot(quad.texture) == -1)
+            {
+                if (batch.textureCount == MaxTextureSlots)
+                    break;
+                batch.textures[batch.textureCount++] = quad.texture;
+            }
+        }
+
+        batch.quadCount = static_cast<int>(batchEnd - batchStart);
+        if (batchType == QuadType::Verts)
+        {
+            // glDrawArrays addresses the buffer in whole vertices
+            bufferRangeSize = (bufferRangeSize + GLVertexSize - 1) / GLVertexSize * GLVertexSize;
+        }
+        batch.bufferOffset = bufferRangeSize;
+        batches.push_back(batch);
+        bufferRangeSize += batch.quadCount * (batchType == QuadType::Instance ? GLInstanceSize : GLQuadSize);
 
-        m_bufferOffset += bufferRangeSize;
         batchStart = batchEnd;
     }
 
-    glBindVertexArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return bufferRangeSize;
 }
 
-void SpriteBatcher::initializeResources()
+template<typename QuadIterator>
+void SpriteBatcher::writeBatches(GLfloat *data, QuadIterator quadsBegin, const SpriteList &sprites,
+                                 const std::vector<Batch> &batches) const
 {
-    glGenBuffers(1, &m_vbo);
-    glGenVertexArrays(1, &m_vao);
+    for (const auto &batch : batches)
+    {
+        auto *batchData = data + batch.bufferOffset;
+        const auto quadsStart = quadsBegin + batch.quadStart;
+        const auto quadsEnd = quadsStart + batch.quadCount;
+        switch (batch.type)
+        {
+        case QuadType::Instance:
+            for (auto it = quadsStart; it != quadsEnd; ++it)
+            {
+                const auto &quad = quadRef(*it);
+                const auto &instance = sprites.instances[quad.index];
+                const auto textureSlot = batch.textureSlot(quad.texture);
+
+                *batchData++ = instance.rect.min.x;
+                *batchData++ = instance.rect.min.y;
+                *batchData++ = instance.rect.max.x;
+                *batchData++ = instance.rect.max.y;
+
+                *batchData++ = instance.textureRect.min.x;
+                *batchData++ = instance.textureRect.min.y;
+                *batchData++ = instance.textureRect.max.x;
+                *batchData++ = instance.textureRect.max.y;
+
+                *batchData++ = instance.fgColor.x;
+                *batchData++ = instance.fgColor.y;
+                *batchData++ = instance.fgColor.z;
+                *batchData++ = instance.fgColor.w;
+
+                *batchData++ = instance.bgColor.x;
+                *batchData++ = instance.bgColor.y;
+                *batchData++ = instance.bgColor.z;
+                *batchData++ = instance.bgColor.w;
+
+                for (int i = 0; i < 3; ++i)
+                {
+                    *batchData++ = instance.transform[i].x;
+                    *batchData++ = instance.transform[i].y;
+                }
+
+                *batchData++ = instance.textureLayer;
+                *batchData++ = textureSlot;
+            }
+            break;
+        case QuadType::Verts:
+            for (auto it = quadsStart; it != quadsEnd; ++it)
+            {
+                const auto &quad = quadRef(*it);
+                const auto &verts = sprites.quadVerts[quad.index];
+                const auto textureSlot = batch.textureSlot(quad.texture);
+
+                const auto emitVertex = [&batchData, &verts, textureSlot](int index) {
+                    const auto &v = verts[index];
+                    *batchData++ = v.position.x;
+                    *batchData++ = v.position.y;
+
+                    *batchData++ = v.textureCoords.x;
+                    *batchData++ = v.textureCoords.y;
+
+                    *batchData++ = v.fgColor.x;
+                    *batchData++ = v.fgColor.y;
+                    *batchData++ = v.fgColor.z;
+                    *batchData++ = v.fgColor.w;
+
+                    *batchData++ = v.bgColor.x;
+                    *batchData++ = v.bgColor.y;
+                    *batchData++ = v.bgColor.z;
+                    *batchData++ = v.bgColor.w;
+
+                    *batchData++ = v.textureLayer;
+                    *batchData++ = textureSlot;
+                };
+
+                emitVertex(0);
+                emitVertex(1);
+                emitVertex(2);
+
+                emitVertex(2);
+                emitVertex(3);
+                emitVertex(0);
+            }
+            break;
+        case QuadType::Layer:
+            break;
+        }
+    }
+}
 
-    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
-    glBindVertexArray(m_vao);
+void SpriteBatcher::drawBatches(const std::vector<Batch> &batches, GLuint buffer, int bufferOffset,
+                                const glm::mat4 &transform, const glm::vec4 &color) const
+{
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    setFrameUniforms(transform, color);
+
+    std::array<const AbstractTexture *, MaxTextureSlots> currentTextures = {};
+    std::optional<ShaderManager::Program> currentProgram = std::nullopt;
+    GLuint currentVao = 0;
+
+    for (const auto &batch : batches)
+    {
+        if (batch.type == QuadType::Layer)
+        {
+            const auto &draw = *batch.layerDraw;
+            const auto &layer = m_layers[draw.layer];
+            if (layer)
+                drawBatches(layer->batches, layer->vbo, 0, transform * draw.transform, color * draw.color);
+
+            // the layer clobbered our bindings and uniforms
+            glBindBuffer(GL_ARRAY_BUFFER, buffer);
+            setFrameUniforms(transform, color);
+            currentTextures.fill(nullptr);
+            currentProgram = std::nullopt;
+            currentVao = 0;
+            continue;
+        }
+
+        for (int slot = 0; slot < batch.textureCount; ++slot)
+        {
+            if (currentTextures[slot] != batch.textures[slot])
+            {
+                currentTextures[slot] = batch.textures[slot];
+                glActiveTexture(GL_TEXTURE0 + slot);
+                currentTextures[slot]->bind();
+                ++m_batchStats.textureBinds;
+            }
+        }
+
+        if (currentProgram != batch.program)
+        {
+            currentProgram = batch.program;
+            m_shaderManager->useProgram(batch.program);
+            if (!m_samplersInitialized[batch.program])
+            {
+                // sampler units never change, so they only need to be set the first time a program is used
+                static const auto textureUnits = [] {
+                    std::vector<int> units(MaxTextureSlots);
+                    std::iota(units.begin(), units.end(), 0);
+                    return units;
+                }();
+                m_shaderManager->setUniform(ShaderManager::Uniform::BaseColorTexture, textureUnits);
+                m_samplersInitialized[batch.program] = true;
+            }
+            ++m_batchStats.programSwitches;
+        }
+
+        const auto batchOffset = bufferOffset + batch.bufferOffset;
+        if (batch.type == QuadType::Instance)
+        {
+            if (currentVao != m_instancedVao)
+            {
+                currentVao = m_instancedVao;
+                glBindVertexArray(m_instancedVao);
+            }
+
+            // no base instance in GLES, so point the per-instance attributes at this run
+            const auto attributePointer = [batchOffset](GLuint index, GLint size, int offset) {
+                glVertexAttribPointer(index, size, GL_FLOAT, GL_FALSE, GLInstanceSize * sizeof(GLfloat),
+                                      reinterpret_cast<GLvoid *>((batchOffset + offset) * sizeof(GLfloat)));
+            };
+            attributePointer(1, 4, 0);  // rect
+            attributePointer(2, 4, 4);  // textureRect
+            attributePointer(3, 4, 8);  // fgColor
+            attributePointer(4, 4, 12); // bgColor
+            attributePointer(5, 2, 16); // transform
+            attributePointer(6, 2, 18);
+            attributePointer(7, 2, 20);
+            attributePointer(8, 1, 22); // textureLayer
+            attributePointer(9, 1, 23); // textureSlot
+
+            glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, QuadCorners.size(), batch.quadCount);
+            ++m_batchStats.drawCalls;
+        }
+        else
+        {
+            if (currentVao != m_vao)
+            {
+                currentVao = m_vao;
+                glBindVertexArray(m_vao);
+                if (m_vaoBuffer != buffer)
+                {
+                    setVertexAttributes();
+                    m_vaoBuffer = buffer;
+                }
+            }
+
+            glDrawArrays(GL_TRIANGLES, batchOffset / GLVertexSize, batch.quadCount * 6);
+            ++m_batchStats.drawCalls;
+        }
+    }
+
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void SpriteBatcher::setVertexAttributes() const
+{
+    constexpr auto Stride = GLVertexSize * sizeof(GLfloat);
 
     // position
 
     glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<GLvoid *>(0));
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, Stride, reinterpret_cast<GLvoid *>(0));
 
     // textureCoords
 
     glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<GLvoid *>(2 * sizeof(GLfloat)));
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, Stride, reinterpret_cast<GLvoid *>(2 * sizeof(GLfloat)));
 
     // fgColor
 
     glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<GLvoid *>(4 * sizeof(GLfloat)));
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, Stride, reinterpret_cast<GLvoid *>(4 * sizeof(GLfloat)));
 
     // bgColor
 
     glEnableVertexAttribArray(3);
-    glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<GLvoid *>(8 * sizeof(GLfloat)));
+    glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, Stride, reinterpret_cast<GLvoid *>(8 * sizeof(GLfloat)));
+
+    // textureLayer
+
+    glEnableVertexAttribArray(4);
+    glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, Stride, reinterpret_cast<GLvoid *>(12 * sizeof(GLfloat)));
+
+    // textureSlot
+
+    glEnableVertexAttribArray(5);
+    glVertexAttribPointer(5, 1, GL_FLOAT, GL_FALSE, Stride, reinterpret_cast<GLvoid *>(13 * sizeof(GLfloat)));
+}
+
+void SpriteBatcher::setFrameUniforms(const glm::mat4 &mvp, const glm::vec4 &colorMultiply) const
+{
+    if (m_frameUniforms && m_frameUniforms->mvp == mvp && m_frameUniforms->colorMultiply == colorMultiply)
+        return;
+    m_frameUniforms = FrameUniforms{mvp, colorMultiply};
+    glBindBuffer(GL_UNIFORM_BUFFER, m_frameUniformsBuffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameUniforms), &*m_frameUniforms);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void SpriteBatcher::initializeResources()
+{
+    glGenBuffers(1, &m_vbo);
+    glGenVertexArrays(1, &m_vao);
+
+    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+    glBindVertexArray(m_vao);
+
+    setVertexAttributes();
+    m_vaoBuffer = m_vbo;
+
+    // instanced quads: a static unit quad, plus per-instance attributes pointed at each run in drawBatches()
+
+    glGenBuffers(1, &m_cornersVbo);
+    glGenVertexArrays(1, &m_instancedVao);
+
+    glBindVertexArray(m_instancedVao);
+
+    glBindBuffer(GL_ARRAY_BUFFER, m_cornersVbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(QuadCorners), QuadCorners.data(), GL_STATIC_DRAW);
+
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), reinterpret_cast<GLvoid *>(0));
+
+    for (GLuint index = 1; index <= 9; ++index)
+    {
+        glEnableVertexAttribArray(index);
+        glVertexAttribDivisor(index, 1);
+    }
 
     glBindVertexArray(0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glGenBuffers(1, &m_frameUniformsBuffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, m_frameUniformsBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
 }
 
 void SpriteBatcher::releaseResources()
 {
+    for (auto &layer : m_layers)
+    {
+        if (layer)
+            glDeleteBuffers(1, &layer->vbo);
+    }
     glDeleteBuffers(1, &m_vbo);
+    glDeleteBuffers(1, &m_cornersVbo);
+    glDeleteBuffers(1, &m_frameUniformsBuffer);
     glDeleteVertexArrays(1, &m_vao);
+    glDeleteVertexArrays(1, &m_instancedVao);
+}
+
+int SpriteBatcher::Batch::textureSlot(const AbstractTexture *texture) const
+{
+    const auto end = textures.begin() + textureCount;
+    const auto it = std::find(textures.begin(), end, texture);
+    return it != end ? it - textures.begin() : -1;
+}
+
+void SpriteBatcher::SpriteList::clear()
+{
+    quads.clear();
+    quadVerts.clear();
+    instances.clear();
+    layerDraws.clear();
 }
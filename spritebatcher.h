@@ -8,6 +8,10 @@
 #include <glm/vec2.hpp>
 
 #include <array>
+#include <memory>
+#include <optional>
+#include <span>
+#include <vector>
 
 class AbstractTexture;
 struct PackedPixmap;
@@ -30,42 +34,222 @@ public:
         glm::vec2 textureCoords;
         glm::vec4 fgColor;
         glm::vec4 bgColor;
+        float textureLayer;
     };
 
     using QuadVerts = std::array<Vertex, 4>;
 
-    void startBatch();
+    // Compact sprite record, expanded to a quad in the vertex shader. Only valid with the instanced programs.
+    struct Instance
+    {
+        BoxF rect;
+        BoxF textureRect;
+        glm::vec4 fgColor;
+        glm::vec4 bgColor;
+        glm::mat3x2 transform;
+        float textureLayer;
+    };
+
+    // Sorted batches are drawn in depth order, grouping quads with the same state within each depth. Immediate batches
+    // are drawn in submission order, ignoring depth, and only adjacent quads with the same state share a draw call.
+    enum class SubmissionMode
+    {
+        Sorted,
+        Immediate
+    };
+
+    void startBatch(SubmissionMode mode = SubmissionMode::Sorted);
     void addSprite(const PackedPixmap &pixmap, const glm::vec2 &topLeft, const glm::vec2 &bottomRight,
                    const glm::vec4 &color, int depth);
     void addSprite(const PackedPixmap &pixmap, const glm::vec2 &topLeft, const glm::vec2 &bottomRight,
                    const glm::vec4 &fgColor, const glm::vec4 &bgColor, int depth);
     void addSprite(const AbstractTexture *texture, const QuadVerts &verts, int depth);
+    void addSprite(const AbstractTexture *texture, const Instance &instance, int depth);
+
+    // Appends count sprites sharing a texture and depth and returns their storage, to be filled in place rather than
+    // copied in. The span is only valid until sprites are added again. A full batch is rendered first to make room,
+    // and fewer sprites than asked for are returned if count doesn't fit in a batch at all. Unused sprites at the end
+    // can be dropped with discardSprites().
+    std::span<QuadVerts> reserveQuads(const AbstractTexture *texture, int count, int depth);
+    std::span<Instance> reserveInstances(const AbstractTexture *texture, int count, int depth);
+    void discardSprites(int count); // removes the last count sprites added
     void renderBatch() const;
 
+    // When enabled, sorted quads are also moved across depth boundaries to join an earlier run with the same state,
+    // as long as their bounds don't intersect anything drawn in between. Off by default.
+    void setOverlapMerging(bool enabled);
+    bool overlapMerging() const;
+
+    // Retained layers: sprites added between startLayer() and finishLayer() are uploaded once to a static buffer
+    // owned by the layer, and drawLayer() then replays them as a single entry of the current batch, with an extra
+    // transform and a color multiplied into the sprite colors. A layer keeps its contents until it is recorded again.
+    using LayerHandle = int;
+    static constexpr LayerHandle InvalidLayer = -1;
+
+    LayerHandle createLayer();
+    void releaseLayer(LayerHandle layer);
+    void startLayer(LayerHandle layer);
+    void finishLayer();
+    void drawLayer(LayerHandle layer, const glm::mat4 &transform, const glm::vec4 &color, int depth);
+
+    // Counters for the work done by renderBatch(). batchStats() covers the last renderBatch() call, frameStats() the
+    // frame in progress (including layer uploads), and endFrame() pushes the latter into a history of recent frames.
+    struct Stats
+    {
+        int quads = 0;
+        int drawCalls = 0;
+        int programSwitches = 0;
+        int textureBinds = 0;
+        int bufferOrphans = 0;
+        std::size_t uploadedBytes = 0;
+
+        Stats &operator+=(const Stats &other);
+    };
+    static constexpr int StatsHistorySize = 120;
+
+    const Stats &batchStats() const;
+    const Stats &frameStats() const;
+    void endFrame();
+    int statsHistorySize() const;
+    const Stats &frameStatsHistory(int framesAgo) const; // 0 is the last finished frame
+
+    // Sprite storage grows on demand. reserve() preallocates room for a batch of the given size, shrink() releases
+    // anything beyond the largest batch seen since the previous shrink().
+    void reserve(int quadCount, int instanceCount = 0);
+    void shrink();
+    int capacity() const;
+
 private:
     void initializeResources();
     void releaseResources();
 
+    enum class QuadType
+    {
+        Verts,
+        Instance,
+        Layer
+    };
+
     struct Quad
     {
         const AbstractTexture *texture;
         ShaderManager::Program program;
-        QuadVerts verts;
         int depth;
+        QuadType type;
+        int index; // into the quadVerts, instances or layerDraws of its SpriteList
+    };
+
+    struct LayerDraw
+    {
+        LayerHandle layer;
+        glm::mat4 transform;
+        glm::vec4 color;
+    };
+
+    struct SpriteList
+    {
+        std::vector<Quad> quads;
+        std::vector<QuadVerts> quadVerts;
+        std::vector<Instance> instances;
+        std::vector<LayerDraw> layerDraws;
+        void clear();
+    };
+
+    // textures of a batch are bound to consecutive texture units, and each vertex selects one with its slot index
+    static constexpr int MaxTextureSlots = 8;
+
+    struct Batch
+    {
+        std::array<const AbstractTexture *, MaxTextureSlots> textures;
+        int textureCount;
+        ShaderManager::Program program;
+        QuadType type;
+        int quadStart;
+        int quadCount;
+        int bufferOffset;           // in floats, relative to the start of the batch buffer range
+        const LayerDraw *layerDraw; // only for QuadType::Layer
+        int textureSlot(const AbstractTexture *texture) const;
+    };
+
+    struct MergeRun
+    {
+        const Quad *quad; // first quad, for the run state
+        BoxF bounds;
+        int head;
+        int tail;
+    };
+
+    struct Layer
+    {
+        GLuint vbo;
+        std::vector<Batch> batches;
+    };
+
+    int makeRoomForSprites(int count);
+    template<typename T>
+    std::span<T> reserveSprites(std::vector<T> SpriteList::*storage, QuadType type, const AbstractTexture *texture,
+                                int count, int depth);
+    void sortQuads(const SpriteList &sprites) const;
+    void mergeQuads(const SpriteList &sprites) const;
+    BoxF quadBounds(const SpriteList &sprites, const Quad &quad) const;
+    template<typename QuadIterator>
+    int layoutBatches(QuadIterator quadsBegin, QuadIterator quadsEnd, const SpriteList &sprites,
+                      std::vector<Batch> &batches) const;
+    template<typename QuadIterator>
+    void writeBatches(GLfloat *data, QuadIterator quadsBegin, const SpriteList &sprites,
+                      const std::vector<Batch> &batches) const;
+    template<typename QuadIterator>
+    int uploadBatches(QuadIterator quadsBegin, QuadIterator quadsEnd, const SpriteList &sprites) const;
+    static const Quad &quadRef(const Quad &quad) { return quad; }
+    static const Quad &quadRef(const Quad *quad) { return *quad; }
+    void drawBatches(const std::vector<Batch> &batches, GLuint buffer, int bufferOffset, const glm::mat4 &transform,
+                     const glm::vec4 &color) const;
+    void setVertexAttributes() const;
+    void setFrameUniforms(const glm::mat4 &mvp, const glm::vec4 &colorMultiply) const;
+
+    // matches the std140 layout of the FrameUniforms block in the 2D shaders
+    struct FrameUniforms
+    {
+        glm::mat4 mvp;
+        glm::vec4 colorMultiply;
     };
 
-    static constexpr int BufferCapacity = 0x100000;                       // in floats
-    static constexpr int GLVertexSize = sizeof(Vertex) / sizeof(GLfloat); // in floats
-    static constexpr int GLQuadSize = 6 * GLVertexSize;                   // 6 verts per quad
-    static constexpr int MaxQuadsPerBatch = BufferCapacity / GLQuadSize;
+    static constexpr int BufferCapacity = 0x100000;                               // in floats
+    static constexpr int GLVertexSize = sizeof(Vertex) / sizeof(GLfloat) + 1;     // in floats, plus texture slot
+    static constexpr int GLQuadSize = 6 * GLVertexSize;                           // 6 verts per quad
+    static constexpr int GLInstanceSize = sizeof(Instance) / sizeof(GLfloat) + 1; // in floats, plus texture slot
+    // leave room for aligning each run of quads to a vertex boundary
+    static constexpr int MaxQuadsPerBatch = BufferCapacity / (GLQuadSize + GLVertexSize);
 
     ShaderManager *m_shaderManager;
-    std::array<Quad, MaxQuadsPerBatch> m_quads;
-    int m_quadCount = 0;
+    SpriteList m_frameSprites;
+    SpriteList m_layerSprites;
+    SpriteList *m_sprites = &m_frameSprites;
+    SubmissionMode m_submissionMode = SubmissionMode::Sorted;
+    LayerHandle m_recordingLayer = InvalidLayer;
+    std::vector<std::unique_ptr<Layer>> m_layers;
+    mutable std::vector<const Quad *> m_sortedQuads;
+    mutable std::vector<Batch> m_batches;
+    bool m_overlapMerging = false;
+    mutable std::vector<MergeRun> m_mergeRuns;
+    mutable std::vector<int> m_mergeNext;
+    mutable std::vector<const Quad *> m_mergeScratch;
+    int m_quadHighWaterMark = 0;
     GLuint m_vao;
+    GLuint m_instancedVao;
     GLuint m_vbo;
+    GLuint m_cornersVbo;
+    GLuint m_frameUniformsBuffer;
+    mutable std::optional<FrameUniforms> m_frameUniforms; // last contents of m_frameUniformsBuffer
+    mutable std::array<bool, ShaderManager::NumPrograms> m_samplersInitialized = {};
+    mutable GLuint m_vaoBuffer; // buffer the vertex attributes of m_vao currently point at
     glm::mat4 m_transformMatrix;
     ShaderManager::Program m_batchProgram = ShaderManager::Program::Text;
     mutable bool m_bufferAllocated = false;
     mutable int m_bufferOffset = 0;
+    mutable Stats m_batchStats;
+    mutable Stats m_frameStats;
+    std::array<Stats, StatsHistorySize> m_statsHistory;
+    int m_statsHistoryHead = 0; // next slot to write
+    int m_statsHistoryCount = 0;
 };
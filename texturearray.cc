@@ -0,0 +1,43 @@
+#include "texturearray.h"
+
+namespace
+{
+constexpr GLenum Target = GL_TEXTURE_2D_ARRAY;
+}
+
+TextureArray::TextureArray(int width, int height, int layerCount, PixelType pixelType)
+    : m_width(width)
+    , m_height(height)
+    , m_layerCount(layerCount)
+    , m_format(pixelType == PixelType::RGBA ? GL_RGBA : GL_RED)
+    , m_internalFormat(pixelType == PixelType::RGBA ? GL_RGBA8 : GL_R8)
+{
+    glGenTextures(1, &m_id);
+
+    bind();
+
+    glTexParameteri(Target, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(Target, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(Target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(Target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    glTexImage3D(Target, 0, m_internalFormat, m_width, m_height, m_layerCount, 0, m_format, GL_UNSIGNED_BYTE,
+                 nullptr);
+}
+
+TextureArray::~TextureArray()
+{
+    glDeleteTextures(1, &m_id);
+}
+
+void TextureArray::setLayerData(int layer, const unsigned char *data) const
+{
+    bind();
+    glTexSubImage3D(Target, 0, 0, 0, layer, m_width, m_height, 1, m_format, GL_UNSIGNED_BYTE, data);
+}
+
+void TextureArray::bind() const
+{
+    glBindTexture(Target, m_id);
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "abstracttexture.h"
+#include "pixeltype.h"
+
+#include <GL/glew.h>
+
+class TextureArray : public AbstractTexture
+{
+public:
+    TextureArray(int width, int height, int layerCount, PixelType pixelType);
+    ~TextureArray() override;
+
+    void setLayerData(int layer, const unsigned char *data) const;
+
+    int width() const { return m_width; }
+    int height() const { return m_height; }
+    int layerCount() const { return m_layerCount; }
+
+    void bind() const override;
+
+private:
+    int m_width;
+    int m_height;
+    int m_layerCount;
+    GLuint m_id;
+    GLint m_internalFormat;
+    GLint m_format;
+};
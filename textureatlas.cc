@@ -7,6 +7,7 @@ TextureAtlas::TextureAtlas(int pageWidth, int pageHeight, PixelType pixelType)
     : m_pageWidth(pageWidth)
     , m_pageHeight(pageHeight)
     , m_pixelType(pixelType)
+    , m_texture(pageWidth, pageHeight, pixelType)
 {
 }
 
@@ -42,41 +43,56 @@ std::optional<PackedPixmap> TextureAtlas::addPixmap(const Pixmap &pm)
     }
 
     std::optional<BoxF> textureCoords;
-    LazyTexture *texture = nullptr;
+    int layer = 0;
 
-    for (auto &entry : m_pages)
+    for (; layer < m_pages.size(); ++layer)
     {
-        if ((textureCoords = entry->page.insert(pm)))
+        if ((textureCoords = m_pages[layer]->insert(pm)))
         {
-            entry->texture.markDirty();
-            texture = &entry->texture;
+            m_texture.markDirty(layer);
             break;
         }
     }
 
     if (!textureCoords)
     {
-        m_pages.emplace_back(new PageTexture(m_pageWidth, m_pageHeight, m_pixelType));
-        auto &entry = m_pages.back();
-        textureCoords = entry->page.insert(pm);
+        m_pages.emplace_back(new TextureAtlasPage(m_pageWidth, m_pageHeight, m_pixelType));
+        auto &page = m_pages.back();
+        textureCoords = page->insert(pm);
         if (!textureCoords)
         {
             // shouldn't ever happen
             assert(false);
             return std::nullopt;
         }
-        texture = &entry->texture;
+        layer = m_texture.addLayer(page->pixmap());
+        assert(layer == m_pages.size() - 1);
     }
 
     PackedPixmap packedPixmap;
     packedPixmap.width = pm.width;
     packedPixmap.height = pm.height;
     packedPixmap.textureCoords = *textureCoords;
-    packedPixmap.texture = texture;
+    packedPixmap.texture = &m_texture;
+    packedPixmap.textureLayer = layer;
 
     return packedPixmap;
 }
 
+std::optional<int> TextureAtlas::addPage(Pixmap pm)
+{
+    if (pm.pixelType != m_pixelType || pm.width != m_pageWidth || pm.height != m_pageHeight)
+    {
+        log("Invalid page for texture atlas\n");
+        return std::nullopt;
+    }
+
+    m_pages.emplace_back(new TextureAtlasPage(std::move(pm)));
+    const auto layer = m_texture.addLayer(m_pages.back()->pixmap());
+    assert(layer == m_pages.size() - 1);
+    return layer;
+}
+
 int TextureAtlas::pageCount() const
 {
     return m_pages.size();
@@ -84,11 +100,10 @@ int TextureAtlas::pageCount() const
 
 const TextureAtlasPage &TextureAtlas::page(int index) const
 {
-    return m_pages[index]->page;
+    return *m_pages[index];
 }
 
-TextureAtlas::PageTexture::PageTexture(int width, int height, PixelType pixelType)
-    : page(width, height, pixelType)
-    , texture(page.pixmap())
+const AbstractTexture *TextureAtlas::texture() const
 {
+    return &m_texture;
 }
@@ -1,6 +1,6 @@
 #pragma once
 
-#include "lazytexture.h"
+#include "lazytexturearray.h"
 #include "pixeltype.h"
 #include "textureatlaspage.h"
 #include "util.h"
@@ -16,6 +16,7 @@ struct PackedPixmap
     int height;
     BoxF textureCoords;
     const AbstractTexture *texture;
+    int textureLayer;
 };
 
 class TextureAtlas
@@ -29,19 +30,19 @@ public:
     PixelType pixelType() const;
 
     std::optional<PackedPixmap> addPixmap(const Pixmap &pixmap);
+    // Adds a page packed ahead of time and returns its layer in texture(). Pixmaps are never added to it.
+    std::optional<int> addPage(Pixmap pixmap);
 
     int pageCount() const;
     const TextureAtlasPage &page(int index) const;
 
+    // all pages are layers of this texture array
+    const AbstractTexture *texture() const;
+
 private:
-    struct PageTexture
-    {
-        PageTexture(int width, int height, PixelType pixelType);
-        TextureAtlasPage page;
-        LazyTexture texture;
-    };
     int m_pageWidth;
     int m_pageHeight;
     PixelType m_pixelType;
-    std::vector<std::unique_ptr<PageTexture>> m_pages;
+    std::vector<std::unique_ptr<TextureAtlasPage>> m_pages;
+    LazyTextureArray m_texture;
 };
@@ -83,6 +83,12 @@ TextureAtlasPage::TextureAtlasPage(int width, int height, PixelType pixelType)
 {
 }
 
+TextureAtlasPage::TextureAtlasPage(Pixmap pixmap)
+    : m_pixmap(std::move(pixmap))
+    , m_tree(std::make_unique<Node>(Node{{0, 0, m_pixmap.width, m_pixmap.height}, {}, {}, true}))
+{
+}
+
 TextureAtlasPage::~TextureAtlasPage() = default;
 
 const Pixmap *TextureAtlasPage::pixmap() const
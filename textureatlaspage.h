@@ -15,6 +15,8 @@ class TextureAtlasPage : private NonCopyable
 {
 public:
     TextureAtlasPage(int width, int height, PixelType pixelType);
+    // a page packed ahead of time, nothing else can be inserted into it
+    explicit TextureAtlasPage(Pixmap pixmap);
     ~TextureAtlasPage();
 
     const Pixmap *pixmap() const;
@@ -0,0 +1,248 @@
+// Rasterizes a set of codepoints for some fonts into texture atlas pages ahead of time, see BakedFonts.
+//
+// usage: fontbaker OUTPUT PAGE_SIZE CHARSET FONT...
+//
+// CHARSET is a comma separated list of codepoints or codepoint ranges (e.g. 0x20-0x7e,0xa0-0xff), and each FONT is
+// PATH:PIXEL_HEIGHT, or PATH:PIXEL_HEIGHT:sdf for a distance field font. Fonts are looked up at runtime by the file
+// name part of PATH.
+
+#include "bakedfontformat.h"
+#include "fontface.h"
+#include "glyphrasterizer.h"
+#include "textureatlaspage.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace
+{
+std::vector<std::string_view> split(std::string_view s, char separator)
+{
+    std::vector<std::string_view> parts;
+    for (;;)
+    {
+        const auto pos = s.find(separator);
+        parts.push_back(s.substr(0, pos));
+        if (pos == std::string_view::npos)
+            break;
+        s.remove_prefix(pos + 1);
+    }
+    return parts;
+}
+
+int parseInt(std::string_view s)
+{
+    return std::strtol(std::string(s).c_str(), nullptr, 0);
+}
+
+std::optional<std::vector<int>> parseCharset(std::string_view charset)
+{
+    std::vector<int> codepoints;
+    for (const auto range : split(charset, ','))
+    {
+        const auto bounds = split(range, '-');
+        if (bounds.size() > 2)
+            return std::nullopt;
+        const auto first = parseInt(bounds.front());
+        const auto last = parseInt(bounds.back());
+        if (first <= 0 || last < first)
+            return std::nullopt;
+        for (int codepoint = first; codepoint <= last; ++codepoint)
+            codepoints.push_back(codepoint);
+    }
+    return codepoints;
+}
+
+struct BakedFont
+{
+    BakedFontFormat::Font font;
+    std::vector<BakedFontFormat::Glyph> glyphs;
+};
+
+class Baker
+{
+public:
+    explicit Baker(int pageSize)
+        : m_pageSize(pageSize)
+    {
+    }
+
+    bool bakeFont(std::string_view spec, const std::vector<int> &codepoints);
+    bool write(const char *path) const;
+
+private:
+    std::optional<std::pair<int, BoxF>> insert(const Pixmap &pixmap);
+
+    int m_pageSize;
+    std::vector<std::unique_ptr<TextureAtlasPage>> m_pages;
+    std::vector<BakedFont> m_fonts;
+};
+
+bool Baker::bakeFont(std::string_view spec, const std::vector<int> &codepoints)
+{
+    const auto parts = split(spec, ':');
+    if (parts.size() < 2 || parts.size() > 3 || (parts.size() == 3 && parts[2] != "sdf"))
+    {
+        std::fprintf(stderr, "Invalid font %.*s\n", static_cast<int>(spec.size()), spec.data());
+        return false;
+    }
+
+    const auto path = std::string(parts[0]);
+    const auto name = path.substr(path.find_last_of('/') + 1);
+    const auto pixelHeight = parseInt(parts[1]);
+    const auto distanceField = parts.size() == 3;
+
+    if (name.size() >= BakedFontFormat::MaxFontNameLength || pixelHeight <= 0)
+    {
+        std::fprintf(stderr, "Invalid font %.*s\n", static_cast<int>(spec.size()), spec.data());
+        return false;
+    }
+
+    FontFace face;
+    if (!face.load(path))
+    {
+        std::fprintf(stderr, "Failed to load font %s\n", path.c_str());
+        return false;
+    }
+    const auto *fontInfo = face.fontInfo();
+    const auto scale = stbtt_ScaleForPixelHeight(fontInfo, pixelHeight);
+
+    auto &baked = m_fonts.emplace_back();
+    std::memset(&baked.font, 0, sizeof(baked.font));
+    std::strncpy(baked.font.name, name.c_str(), sizeof(baked.font.name) - 1);
+    baked.font.pixelHeight = pixelHeight;
+    baked.font.distanceField = distanceField;
+
+    for (const auto codepoint : codepoints)
+    {
+        // missing glyphs are left to the runtime, which draws them as the font's fallback glyph
+        if (stbtt_FindGlyphIndex(fontInfo, codepoint) == 0)
+            continue;
+
+        BoxI boundingBox;
+        const auto pixmap = rasterizeGlyph(fontInfo, scale, codepoint, distanceField, boundingBox);
+        const auto packed = insert(pixmap);
+        if (!packed)
+        {
+            std::fprintf(stderr, "Glyph %d of %s doesn't fit in a page\n", codepoint, path.c_str());
+            continue;
+        }
+
+        int advanceWidth, leftSideBearing;
+        stbtt_GetCodepointHMetrics(fontInfo, codepoint, &advanceWidth, &leftSideBearing);
+
+        const auto &[page, textureCoords] = *packed;
+
+        BakedFontFormat::Glyph glyph;
+        glyph.codepoint = codepoint;
+        glyph.boundingBox[0] = boundingBox.min.x;
+        glyph.boundingBox[1] = boundingBox.min.y;
+        glyph.boundingBox[2] = boundingBox.max.x;
+        glyph.boundingBox[3] = boundingBox.max.y;
+        glyph.advanceWidth = scale * advanceWidth;
+        glyph.textureCoords[0] = textureCoords.min.x;
+        glyph.textureCoords[1] = textureCoords.min.y;
+        glyph.textureCoords[2] = textureCoords.max.x;
+        glyph.textureCoords[3] = textureCoords.max.y;
+        glyph.page = page;
+        glyph.width = pixmap.width;
+        glyph.height = pixmap.height;
+        baked.glyphs.push_back(glyph);
+    }
+    baked.font.glyphCount = baked.glyphs.size();
+
+    return true;
+}
+
+std::optional<std::pair<int, BoxF>> Baker::insert(const Pixmap &pixmap)
+{
+    if (pixmap.width > m_pageSize || pixmap.height > m_pageSize)
+        return std::nullopt;
+
+    for (int page = 0; page < m_pages.size(); ++page)
+    {
+        if (const auto textureCoords = m_pages[page]->insert(pixmap))
+            return std::make_pair(page, *textureCoords);
+    }
+
+    m_pages.emplace_back(new TextureAtlasPage(m_pageSize, m_pageSize, PixelType::Grayscale));
+    const auto textureCoords = m_pages.back()->insert(pixmap);
+    if (!textureCoords)
+        return std::nullopt;
+    return std::make_pair(static_cast<int>(m_pages.size()) - 1, *textureCoords);
+}
+
+bool Baker::write(const char *path) const
+{
+    auto *file = std::fopen(path, "wb");
+    if (!file)
+    {
+        std::fprintf(stderr, "Failed to open %s\n", path);
+        return false;
+    }
+
+    BakedFontFormat::Header header;
+    header.magic = BakedFontFormat::Magic;
+    header.version = BakedFontFormat::Version;
+    header.pageWidth = m_pageSize;
+    header.pageHeight = m_pageSize;
+    header.pageCount = m_pages.size();
+    header.fontCount = m_fonts.size();
+    std::fwrite(&header, sizeof(header), 1, file);
+
+    for (const auto &page : m_pages)
+    {
+        const auto &pixels = page->pixmap()->pixels;
+        std::fwrite(pixels.data(), 1, pixels.size(), file);
+    }
+
+    for (const auto &baked : m_fonts)
+    {
+        std::fwrite(&baked.font, sizeof(baked.font), 1, file);
+        std::fwrite(baked.glyphs.data(), sizeof(BakedFontFormat::Glyph), baked.glyphs.size(), file);
+    }
+
+    const auto ok = std::ferror(file) == 0;
+    std::fclose(file);
+    return ok;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    if (argc < 5)
+    {
+        std::fprintf(stderr, "usage: %s OUTPUT PAGE_SIZE CHARSET FONT...\n", argv[0]);
+        return 1;
+    }
+
+    const auto pageSize = parseInt(argv[2]);
+    if (pageSize <= 0)
+    {
+        std::fprintf(stderr, "Invalid page size %s\n", argv[2]);
+        return 1;
+    }
+
+    const auto codepoints = parseCharset(argv[3]);
+    if (!codepoints)
+    {
+        std::fprintf(stderr, "Invalid charset %s\n", argv[3]);
+        return 1;
+    }
+
+    Baker baker(pageSize);
+    for (int i = 4; i < argc; ++i)
+    {
+        if (!baker.bakeFont(argv[i], *codepoints))
+            return 1;
+    }
+
+    return baker.write(argv[1]) ? 0 : 1;
+}
@@ -0,0 +1,70 @@
+#include "transform2d.h"
+
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+void Transform2D::map(const glm::vec2 *points, glm::vec2 *result, int count) const
+{
+    switch (m_kind)
+    {
+    case Kind::Identity:
+        if (points != result)
+            std::copy_n(points, count, result);
+        return;
+    case Kind::Translation:
+        for (int i = 0; i < count; ++i)
+            result[i] = points[i] + m_translation;
+        return;
+    case Kind::Affine:
+        break;
+    }
+
+    int i = 0;
+#if defined(__SSE2__)
+    // two points per iteration: [x0 y0 x1 y1] -> [x0 x0 x1 x1] * column 0 + [y0 y0 y1 y1] * column 1 + translation
+    const auto column0 = _mm_setr_ps(m_linear[0].x, m_linear[0].y, m_linear[0].x, m_linear[0].y);
+    const auto column1 = _mm_setr_ps(m_linear[1].x, m_linear[1].y, m_linear[1].x, m_linear[1].y);
+    const auto translation = _mm_setr_ps(m_translation.x, m_translation.y, m_translation.x, m_translation.y);
+    for (; count - i >= 2; i += 2)
+    {
+        const auto p = _mm_loadu_ps(&points[i].x);
+        const auto xs = _mm_shuffle_ps(p, p, _MM_SHUFFLE(2, 2, 0, 0));
+        const auto ys = _mm_shuffle_ps(p, p, _MM_SHUFFLE(3, 3, 1, 1));
+        const auto mapped = _mm_add_ps(_mm_add_ps(_mm_mul_ps(xs, column0), _mm_mul_ps(ys, column1)), translation);
+        _mm_storeu_ps(&result[i].x, mapped);
+    }
+#endif
+    for (; i < count; ++i)
+        result[i] = m_linear * points[i] + m_translation;
+}
+
+BoxF Transform2D::mapBounds(const BoxF &box) const
+{
+    switch (m_kind)
+    {
+    case Kind::Identity:
+        return box;
+    case Kind::Translation:
+        return BoxF{box.min + m_translation, box.max + m_translation};
+    case Kind::Affine:
+    default:
+        break;
+    }
+
+    const auto center = m_linear * (0.5f * (box.min + box.max)) + m_translation;
+    const auto halfSize = 0.5f * (box.max - box.min);
+    const auto extent = glm::abs(m_linear[0]) * halfSize.x + glm::abs(m_linear[1]) * halfSize.y;
+    return BoxF{center - extent, center + extent};
+}
+
+glm::mat4 Transform2D::matrix4() const
+{
+    auto result = glm::mat4(1);
+    result[0] = glm::vec4(m_linear[0], 0, 0);
+    result[1] = glm::vec4(m_linear[1], 0, 0);
+    result[3] = glm::vec4(m_translation, 0, 1);
+    return result;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "util.h"
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+
+// 2D affine transform, stored as a 2x2 linear part plus a translation. Whether it's the identity or a pure
+// translation is tracked as it's built, so that mapping points can skip the matrix multiply in the common cases.
+// Like glm, translate(), scale() and rotate() apply the new transform before the existing one.
+class Transform2D
+{
+public:
+    enum class Kind
+    {
+        Identity,
+        Translation,
+        Affine
+    };
+
+    Kind kind() const { return m_kind; }
+    const glm::mat2 &linear() const { return m_linear; }
+    const glm::vec2 &translation() const { return m_translation; }
+
+    void reset()
+    {
+        m_linear = glm::mat2(1);
+        m_translation = glm::vec2(0);
+        m_kind = Kind::Identity;
+    }
+
+    void translate(const glm::vec2 &offset)
+    {
+        m_translation += m_linear * offset;
+        if (m_kind == Kind::Identity && offset != glm::vec2(0))
+            m_kind = Kind::Translation;
+    }
+
+    void scale(const glm::vec2 &factor)
+    {
+        m_linear[0] *= factor.x;
+        m_linear[1] *= factor.y;
+        if (factor != glm::vec2(1))
+            m_kind = Kind::Affine;
+    }
+
+    void rotate(float angle)
+    {
+        const auto c = std::cos(angle);
+        const auto s = std::sin(angle);
+        const auto column0 = m_linear[0];
+        m_linear[0] = c * column0 + s * m_linear[1];
+        m_linear[1] = c * m_linear[1] - s * column0;
+        if (angle != 0.0f)
+            m_kind = Kind::Affine;
+    }
+
+    glm::vec2 map(const glm::vec2 &point) const
+    {
+        switch (m_kind)
+        {
+        case Kind::Identity:
+            return point;
+        case Kind::Translation:
+            return point + m_translation;
+        case Kind::Affine:
+        default:
+            return m_linear * point + m_translation;
+        }
+    }
+
+    // Maps count points at once, in place if points == result.
+    void map(const glm::vec2 *points, glm::vec2 *result, int count) const;
+
+    // Axis aligned bounds of the transformed box.
+    BoxF mapBounds(const BoxF &box) const;
+
+    glm::mat3x2 matrix() const { return glm::mat3x2(m_linear[0], m_linear[1], m_translation); }
+    glm::mat4 matrix4() const;
+
+private:
+    glm::mat2 m_linear = glm::mat2(1);
+    glm::vec2 m_translation = glm::vec2(0);
+    Kind m_kind = Kind::Identity;
+};
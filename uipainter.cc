@@ -1,30 +1,83 @@
 #include "uipainter.h"
 
+#include "bakedfonts.h"
 #include "fontcache.h"
+#include "fontface.h"
+#include "glyphrasterizerthread.h"
+#include "glyphruncache.h"
 #include "shadermanager.h"
 #include "spritebatcher.h"
+#include "utf8.h"
 #include "log.h"
 
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/string_cast.hpp>
-#include <numeric>
+
+#include <array>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 using namespace std::string_literals;
 
 namespace
 {
-constexpr auto TextureAtlasPageSize = 512;
+constexpr auto TextureAtlasPageSize = FONT_ATLAS_PAGE_SIZE; // shared with the font baker, see CMakeLists.txt
+constexpr auto BakedFontsPath = "baked/fonts.bin";
+constexpr auto GlyphPixelBudgetPerFrame = 64 * 1024; // rasterized glyph pixels added to the atlas per frame
 
 std::string fontPath(std::string_view basename)
 {
     return std::string("assets/fonts/") + std::string(basename);
 }
+
+// Writes the unit left hand normal of each of the segmentCount segments between consecutive points. Zero length
+// segments get a zero normal.
+void segmentNormals(const glm::vec2 *points, glm::vec2 *normals, int segmentCount)
+{
+    constexpr auto MinLengthSquared = 1e-12f;
+    int i = 0;
+#if defined(__SSE2__)
+    // two segments per iteration, as [x0 y0 x1 y1]
+    const auto minLengthSquared = _mm_set1_ps(MinLengthSquared);
+    const auto sign = _mm_setr_ps(-1.0f, 1.0f, -1.0f, 1.0f);
+    for (; segmentCount - i >= 2; i += 2)
+    {
+        const auto delta = _mm_sub_ps(_mm_loadu_ps(&points[i + 1].x), _mm_loadu_ps(&points[i].x));
+        const auto squares = _mm_mul_ps(delta, delta);
+        const auto lengthSquared = _mm_add_ps(squares, _mm_shuffle_ps(squares, squares, _MM_SHUFFLE(2, 3, 0, 1)));
+        const auto nonZero = _mm_cmpgt_ps(lengthSquared, minLengthSquared);
+        const auto direction =
+            _mm_and_ps(_mm_div_ps(delta, _mm_sqrt_ps(_mm_max_ps(lengthSquared, minLengthSquared))), nonZero);
+        // (x, y) -> (-y, x)
+        const auto normal = _mm_mul_ps(_mm_shuffle_ps(direction, direction, _MM_SHUFFLE(2, 3, 0, 1)), sign);
+        _mm_storeu_ps(&normals[i].x, normal);
+    }
+#endif
+    for (; i < segmentCount; ++i)
+    {
+        const auto delta = points[i + 1] - points[i];
+        const auto lengthSquared = glm::dot(delta, delta);
+        const auto direction = lengthSquared > MinLengthSquared ? delta / std::sqrt(lengthSquared) : glm::vec2(0);
+        normals[i] = glm::vec2(-direction.y, direction.x);
+    }
+}
 } // namespace
 
 UIPainter::UIPainter(ShaderManager *shaderManager)
     : m_spriteBatcher(new SpriteBatcher(shaderManager))
     , m_textureAtlas(new TextureAtlas(TextureAtlasPageSize, TextureAtlasPageSize, PixelType::Grayscale))
+    , m_glyphRunCache(new GlyphRunCache)
+    , m_bakedFonts(new BakedFonts)
 {
+    // optional, any glyph that wasn't baked is rasterized when first used
+    m_bakedFonts->load(BakedFontsPath, m_textureAtlas.get());
+
+#if !defined(__EMSCRIPTEN__) || defined(__EMSCRIPTEN_PTHREADS__)
+    // without threads, glyphs are rasterized synchronously the first time they're drawn
+    m_glyphRasterizerThread = std::make_unique<GlyphRasterizerThread>();
+#endif
 }
 
 UIPainter::~UIPainter() = default;
@@ -32,89 +85,180 @@ UIPainter::~UIPainter() = default;
 void UIPainter::resize(int width, int height)
 {
     updateSceneBox(width, height);
+    updateCullBox();
 
     const auto projectionMatrix =
         glm::ortho(m_sceneBox.min.x, m_sceneBox.max.x, m_sceneBox.max.y, m_sceneBox.min.y, -1.0f, 1.0f);
     m_spriteBatcher->setTransformMatrix(projectionMatrix);
 }
 
-void UIPainter::startPainting()
+void UIPainter::startPainting(SpriteBatcher::SubmissionMode mode)
 {
     m_transformStack.clear();
+    m_cullRectStack.clear();
+    updateCullBox();
     resetTransform();
     m_font = nullptr;
-    m_spriteBatcher->startBatch();
+    if (m_glyphRasterizerThread)
+        m_glyphRasterizerThread->processResults(GlyphPixelBudgetPerFrame);
+    m_spriteBatcher->startBatch(mode);
 }
 
 void UIPainter::donePainting()
 {
     m_spriteBatcher->renderBatch();
+    m_spriteBatcher->endFrame();
 }
 
 void UIPainter::setFont(const Font &font)
 {
-    auto it = m_fonts.find(font);
+    // all sizes of a distance field font are drawn from the same glyphs, scaled. The key is a member so that its name
+    // keeps its storage between calls, and looking up a font doesn't allocate.
+    auto &key = m_fontKey;
+    key.name = font.name;
+    key.pixelHeight = font.distanceField ? FontCache::DistanceFieldPixelHeight : font.pixelHeight;
+    key.distanceField = font.distanceField;
+
+    auto it = m_fonts.find(key);
     if (it == m_fonts.end())
     {
+        if (m_failedFonts.contains(key))
+        {
+            m_font = nullptr;
+            return;
+        }
         auto fontCache = std::make_unique<FontCache>(m_textureAtlas.get());
-        const auto path = fontPath(font.name);
-        if (!fontCache->load(path, font.pixelHeight))
+        fontCache->setRasterizerThread(glyphRasterizerThread());
+        if (!fontCache->load(fontFace(key.name), key.pixelHeight, key.distanceField))
         {
-            log("Failed to load font %s\n", path.c_str());
+            // not cached, the text drawing functions then report that no font is set. Remembered so that it's only
+            // attempted (and reported) once.
+            log("Failed to load font %s\n", key.name.c_str());
+            m_failedFonts.insert(key);
+            m_font = nullptr;
+            return;
         }
-        it = m_fonts.emplace(font, std::move(fontCache)).first;
+        if (const auto *bakedGlyphs = m_bakedFonts->glyphs(key.name, key.pixelHeight, key.distanceField))
+        {
+            for (const auto &baked : *bakedGlyphs)
+                fontCache->addGlyph(baked.codepoint, baked.glyph);
+        }
+        it = m_fonts.emplace(key, std::move(fontCache)).first;
     }
     m_font = it->second.get();
+    m_fontScale = static_cast<float>(font.pixelHeight) / key.pixelHeight;
+}
+
+std::shared_ptr<FontFace> UIPainter::fontFace(const std::string &name)
+{
+    auto &entry = m_fontFaces[name];
+    if (auto face = entry.lock())
+        return face;
+
+    auto face = std::make_shared<FontFace>();
+    const auto path = fontPath(name);
+    if (!face->load(path))
+    {
+        log("Failed to load font file %s\n", path.c_str());
+        return {};
+    }
+    entry = face;
+    return face;
 }
 
 template<typename StringT>
 void UIPainter::drawText(const glm::vec2 &pos, const glm::vec4 &color, int depth, const StringT &text)
+{
+    drawText(pos, color, depth, text, HorizontalAlign::Left);
+}
+
+template<typename StringT>
+float UIPainter::drawText(const glm::vec2 &pos, const glm::vec4 &color, int depth, const StringT &text,
+                          HorizontalAlign align)
 {
     if (!m_font)
     {
         log("No font set lol\n");
-        return;
+        return 0.0f;
     }
 
-    glm::vec2 glyphPosition = pos;
+    m_spriteBatcher->setBatchProgram(m_font->isDistanceField() ? ShaderManager::Program::TextDistanceFieldInstanced
+                                                               : ShaderManager::Program::TextInstanced);
+    const auto transform = m_transform.matrix();
 
-    m_spriteBatcher->setBatchProgram(ShaderManager::Program::Text);
-
-    for (auto ch : text)
+    const auto &run = m_glyphRunCache->run(m_font, text);
+    const auto advance = m_fontScale * run.advance;
+    const auto origin = [&pos, advance, align] {
+        switch (align)
+        {
+        case HorizontalAlign::Left:
+            return pos;
+        case HorizontalAlign::Right:
+            return pos - glm::vec2(advance, 0.0f);
+        case HorizontalAlign::Center:
+        default:
+            return pos - glm::vec2(0.5f * advance, 0.0f);
+        }
+    }();
+    // glyphs are written straight into the batcher, one reservation per run of glyphs with the same texture (usually
+    // the whole text, since glyphs normally share the atlas texture)
+    const auto &glyphs = run.glyphs;
+    for (std::size_t first = 0; first < glyphs.size();)
     {
-        const auto glyph = m_font->getGlyph(ch);
-        if (!glyph)
-            continue;
-        const auto p0 = glyphPosition + glm::vec2(glyph->boundingBox.min);
-        const auto p1 = p0 + glm::vec2(glyph->boundingBox.max - glyph->boundingBox.min);
-
-        const auto &pixmap = glyph->pixmap;
-
-        const auto &textureCoords = pixmap.textureCoords;
-        const auto &t0 = textureCoords.min;
-        const auto &t1 = textureCoords.max;
-
-        addQuad(pixmap.texture, {{p0.x, p0.y}, {t0.x, t0.y}}, {{p1.x, p0.y}, {t1.x, t0.y}},
-                {{p1.x, p1.y}, {t1.x, t1.y}}, {{p0.x, p1.y}, {t0.x, t1.y}}, color, glm::vec4(0), depth);
-
-        glyphPosition += glm::vec2(glyph->advanceWidth, 0);
+        const auto *texture = glyphs[first].texture;
+        auto last = first + 1;
+        while (last < glyphs.size() && glyphs[last].texture == texture)
+            ++last;
+
+        const auto instances = m_spriteBatcher->reserveInstances(texture, last - first, depth);
+        std::size_t used = 0;
+        for (std::size_t i = first; i < first + instances.size(); ++i)
+        {
+            const auto &glyph = glyphs[i];
+            const auto p0 = origin + m_fontScale * glyph.rect.min;
+            const auto p1 = origin + m_fontScale * glyph.rect.max;
+            if (isCulled(m_transform.mapBounds({p0, p1})))
+                continue;
+
+            auto &instance = instances[used++];
+            instance.rect = {p0, p1};
+            instance.textureRect = glyph.textureCoords;
+            instance.fgColor = color;
+            instance.bgColor = glm::vec4(0);
+            instance.transform = transform;
+            instance.textureLayer = glyph.textureLayer;
+        }
+        m_spriteBatcher->discardSprites(instances.size() - used);
+        first += instances.size();
     }
+    return advance;
 }
 
 template void UIPainter::drawText(const glm::vec2 &pos, const glm::vec4 &color, int depth, const std::u32string &text);
 template void UIPainter::drawText(const glm::vec2 &pos, const glm::vec4 &color, int depth, const std::string &text);
+template void UIPainter::drawText(const glm::vec2 &pos, const glm::vec4 &color, int depth,
+                                  const std::string_view &text);
+template float UIPainter::drawText(const glm::vec2 &pos, const glm::vec4 &color, int depth, const std::u32string &text,
+                                   HorizontalAlign align);
+template float UIPainter::drawText(const glm::vec2 &pos, const glm::vec4 &color, int depth, const std::string &text,
+                                   HorizontalAlign align);
+template float UIPainter::drawText(const glm::vec2 &pos, const glm::vec4 &color, int depth,
+                                   const std::string_view &text, HorizontalAlign align);
 
 template<typename StringT>
 float UIPainter::horizontalAdvance(const StringT &text)
 {
-    return std::accumulate(text.begin(), text.end(), 0.0f, [this](float advance, auto ch) {
-        const auto *g = m_font->getGlyph(ch);
-        return advance + g->advanceWidth;
-    });
+    if (!m_font)
+    {
+        log("No font set lol\n");
+        return 0.0f;
+    }
+    return m_fontScale * m_glyphRunCache->run(m_font, text).advance;
 }
 
 template float UIPainter::horizontalAdvance(const std::u32string &text);
 template float UIPainter::horizontalAdvance(const std::string &text);
+template float UIPainter::horizontalAdvance(const std::string_view &text);
 
 void UIPainter::drawTextBox(const BoxF &box, const glm::vec4 &color, int depth, const std::string &text)
 {
@@ -124,27 +268,70 @@ void UIPainter::drawTextBox(const BoxF &box, const glm::vec4 &color, int depth,
         return;
     }
 
-    const auto rows = breakTextLines(text, box.width());
+    const auto maxWidth = box.width() / m_fontScale;
+
+    ++m_paragraphLayoutClock;
+
+    auto *leastRecentlyUsed = &m_paragraphLayouts.front();
+    for (auto &entry : m_paragraphLayouts)
+    {
+        if (entry.layout.matches(m_font, text, maxWidth))
+        {
+            entry.lastUsed = m_paragraphLayoutClock;
+            drawParagraph(box, color, depth, entry.layout);
+            return;
+        }
+        if (entry.lastUsed < leastRecentlyUsed->lastUsed)
+            leastRecentlyUsed = &entry;
+    }
+
+    leastRecentlyUsed->lastUsed = m_paragraphLayoutClock;
+    drawTextBox(box, color, depth, text, leastRecentlyUsed->layout);
+}
+
+void UIPainter::drawTextBox(const BoxF &box, const glm::vec4 &color, int depth, const std::string &text,
+                            ParagraphLayout &layout)
+{
+    if (!m_font)
+    {
+        log("No font set lol\n");
+        return;
+    }
 
-    auto y = [this, &box, rowCount = rows.size()] {
-        const auto textHeight = rowCount * (m_font->ascent() - m_font->descent()) + (rowCount - 1) * m_font->lineGap();
+    if (layout.update(m_font, text, box.width() / m_fontScale))
+    {
+        for (const auto &row : layout.rows())
+            assert(std::abs(horizontalAdvance(layout.rowText(row)) - m_fontScale * row.width) < 1e-3);
+    }
+    drawParagraph(box, color, depth, layout);
+}
+
+void UIPainter::drawParagraph(const BoxF &box, const glm::vec4 &color, int depth, const ParagraphLayout &layout)
+{
+    const auto &rows = layout.rows();
+
+    const auto ascent = m_fontScale * m_font->ascent();
+    const auto descent = m_fontScale * m_font->descent();
+    const auto lineGap = m_fontScale * m_font->lineGap();
+
+    auto y = [this, &box, ascent, descent, lineGap, rowCount = rows.size()] {
+        const auto textHeight = rowCount * (ascent - descent) + (rowCount - 1) * lineGap;
 
         switch (m_verticalAlign)
         {
         case VerticalAlign::Top:
-            return box.min.y + m_font->ascent();
+            return box.min.y + ascent;
         case VerticalAlign::Bottom:
-            return box.max.y - textHeight + m_font->ascent();
+            return box.max.y - textHeight + ascent;
         case VerticalAlign::Middle:
         default:
-            return 0.5f * (box.min.y + box.max.y) - 0.5f * textHeight + m_font->ascent();
+            return 0.5f * (box.min.y + box.max.y) - 0.5f * textHeight + ascent;
         }
     }();
-    const auto lineHeight = m_font->ascent() - m_font->descent() + m_font->lineGap();
+    const auto lineHeight = ascent - descent + lineGap;
     for (const auto &row : rows)
     {
-        assert(std::abs(horizontalAdvance(row.text) - row.width) < 1e-3);
-        const float x = [this, &box, rowWidth = row.width] {
+        const float x = [this, &box, rowWidth = m_fontScale * row.width] {
             switch (m_horizontalAlign)
             {
             case HorizontalAlign::Left:
@@ -156,7 +343,7 @@ void UIPainter::drawTextBox(const BoxF &box, const glm::vec4 &color, int depth,
                 return 0.5f * (box.min.x + box.max.x) - 0.5f * rowWidth;
             }
         }();
-        drawText(glm::vec2(x, y), color, depth, row.text);
+        drawText(glm::vec2(x, y), color, depth, layout.rowText(row));
         y += lineHeight;
     }
 }
@@ -166,71 +353,265 @@ void UIPainter::drawCircle(const glm::vec2 &center, float radius, const glm::vec
     const auto &p0 = center - glm::vec2(radius, radius);
     const auto &p1 = center + glm::vec2(radius, radius);
 
-    m_spriteBatcher->setBatchProgram(ShaderManager::Program::Circle);
-    addQuad(nullptr, {{p0.x, p0.y}, {0.0f, 0.0f}}, {{p1.x, p0.y}, {1.0f, 0.0f}}, {{p1.x, p1.y}, {1.0f, 1.0f}},
-            {{p0.x, p1.y}, {0.0f, 1.0f}}, color, {2.0f * radius, 0, 0, 0}, depth);
+    if (isCulled(m_transform.mapBounds({p0, p1})))
+        return;
+    m_spriteBatcher->setBatchProgram(ShaderManager::Program::CircleInstanced);
+    const auto textureRect = BoxF{{0.0f, 0.0f}, {1.0f, 1.0f}};
+    const auto bgColor = glm::vec4(2.0f * radius, 0, 0, 0);
+    const auto instance = SpriteBatcher::Instance{{p0, p1}, textureRect, color, bgColor, m_transform.matrix(), 0.0f};
+    m_spriteBatcher->addSprite(nullptr, instance, depth);
 }
 
-void UIPainter::addQuad(const AbstractTexture *texture, const Vertex &v0, const Vertex &v1, const Vertex &v2,
-                        const Vertex &v3, const glm::vec4 &fgColor, const glm::vec4 &bgColor, int depth)
+bool UIPainter::isCulled(const BoxF &bounds) const
 {
-    const auto quad = SpriteBatcher::QuadVerts{
-        {{glm::vec2(m_transform * glm::vec4(v0.position, 0, 1)), v0.textureCoords, fgColor, bgColor},
-         {glm::vec2(m_transform * glm::vec4(v1.position, 0, 1)), v1.textureCoords, fgColor, bgColor},
-         {glm::vec2(m_transform * glm::vec4(v2.position, 0, 1)), v2.textureCoords, fgColor, bgColor},
-         {glm::vec2(m_transform * glm::vec4(v3.position, 0, 1)), v3.textureCoords, fgColor, bgColor}}};
-    m_spriteBatcher->addSprite(texture, quad, depth);
+    return !m_recordingLayer && !m_cullBox.intersects(bounds);
 }
 
-void UIPainter::drawRoundedRect(const BoxF &box, float radius, const glm::vec4 &color, int depth)
+void UIPainter::updateCullBox()
 {
-    m_spriteBatcher->setBatchProgram(ShaderManager::Program::Circle);
+    m_cullBox = m_cullRectStack.empty() ? m_sceneBox : m_sceneBox & m_cullRectStack.back();
+}
 
-    const auto drawPatch = [this, radius, &color, depth](const glm::vec2 &p0, const glm::vec2 &p1, const glm::vec2 &t0,
-                                                         const glm::vec2 &t1) {
-        addQuad(nullptr, {{p0.x, p0.y}, {t0.x, t0.y}}, {{p1.x, p0.y}, {t1.x, t0.y}}, {{p1.x, p1.y}, {t1.x, t1.y}},
-                {{p0.x, p1.y}, {t0.x, t1.y}}, color, {2.0f * radius, 0, 0, 0}, depth);
-    };
+void UIPainter::pushCullRect(const BoxF &rect)
+{
+    // each entry is already intersected with the ones below it
+    m_cullRectStack.push_back(m_cullRectStack.empty() ? rect : rect & m_cullRectStack.back());
+    updateCullBox();
+}
 
-    const auto x0 = box.min.x;
-    const auto x1 = box.min.x + radius;
-    const auto x2 = box.max.x - radius;
-    const auto x3 = box.max.x;
+void UIPainter::popCullRect()
+{
+    if (m_cullRectStack.empty())
+    {
+        log("Cull rect stack underflow lol\n");
+        return;
+    }
+    m_cullRectStack.pop_back();
+    updateCullBox();
+}
 
-    const auto y0 = box.min.y;
-    const auto y1 = box.min.y + radius;
-    const auto y2 = box.max.y - radius;
-    const auto y3 = box.max.y;
+void UIPainter::drawRoundedRect(const BoxF &box, float radius, const glm::vec4 &color, int depth)
+{
+    drawRoundedRect(box, radius, color, 0.0f, glm::vec4(0), 0.0f, depth);
+}
 
-    drawPatch(glm::vec2(x0, y0), glm::vec2(x1, y1), glm::vec2(0.0, 0.0), glm::vec2(0.5, 0.5));
-    drawPatch(glm::vec2(x1, y0), glm::vec2(x2, y1), glm::vec2(0.5, 0.0), glm::vec2(0.5, 0.5));
-    drawPatch(glm::vec2(x2, y0), glm::vec2(x3, y1), glm::vec2(0.5, 0.0), glm::vec2(1.0, 0.5));
+void UIPainter::drawRoundedRect(const BoxF &box, float radius, const glm::vec4 &fillColor, float borderWidth,
+                                const glm::vec4 &borderColor, float blur, int depth)
+{
+    if (isCulled(m_transform.mapBounds({box.min - glm::vec2(blur), box.max + glm::vec2(blur)})))
+        return;
 
-    drawPatch(glm::vec2(x0, y1), glm::vec2(x1, y2), glm::vec2(0.0, 0.5), glm::vec2(0.5, 0.5));
-    drawPatch(glm::vec2(x1, y1), glm::vec2(x2, y2), glm::vec2(0.5, 0.5), glm::vec2(0.5, 0.5));
-    drawPatch(glm::vec2(x2, y1), glm::vec2(x3, y2), glm::vec2(0.5, 0.5), glm::vec2(1.0, 0.5));
+    radius = std::min(radius, 0.5f * std::min(box.width(), box.height()));
 
-    drawPatch(glm::vec2(x0, y2), glm::vec2(x1, y3), glm::vec2(0.0, 0.5), glm::vec2(0.5, 1.0));
-    drawPatch(glm::vec2(x1, y2), glm::vec2(x2, y3), glm::vec2(0.5, 0.5), glm::vec2(0.5, 1.0));
-    drawPatch(glm::vec2(x2, y2), glm::vec2(x3, y3), glm::vec2(0.5, 0.5), glm::vec2(1.0, 1.0));
+    m_spriteBatcher->setBatchProgram(ShaderManager::Program::RoundedRectInstanced);
+    auto &instance = m_spriteBatcher->reserveInstances(nullptr, 1, depth)[0];
+    instance.rect = box;
+    instance.textureRect = BoxF{{radius, borderWidth}, {blur, 0.0f}}; // shape parameters, see rounded_rect.frag
+    instance.fgColor = fillColor;
+    instance.bgColor = borderColor;
+    instance.transform = m_transform.matrix();
+    instance.textureLayer = 0.0f;
 }
 
 void UIPainter::drawThickLine(const glm::vec2 &from, const glm::vec2 &to, float thickness, const glm::vec4 &color,
                               int depth)
 {
+    const auto points = std::array{from, to};
+    drawPolyline(points, thickness, color, JoinStyle::Miter, depth);
+}
+
+void UIPainter::drawPolyline(std::span<const glm::vec2> points, float thickness, const glm::vec4 &color,
+                             JoinStyle join, int depth)
+{
+    if (points.size() < 2)
+        return;
+
+    const auto segmentCount = static_cast<int>(points.size()) - 1;
+    auto &normals = m_polylineNormals;
+    normals.resize(segmentCount);
+    segmentNormals(points.data(), normals.data(), segmentCount);
+
+    // zero length segments (repeated points) take the normal of the previous segment, or of the first non-zero one
+    // at the start, so they don't affect the joins around them
+    const auto firstNonZero = std::find_if(normals.begin(), normals.end(),
+                                           [](const glm::vec2 &normal) { return normal != glm::vec2(0); });
+    if (firstNonZero == normals.end())
+        return;
+    std::fill(normals.begin(), firstNonZero, *firstNonZero);
+    for (auto it = firstNonZero + 1; it != normals.end(); ++it)
+    {
+        if (*it == glm::vec2(0))
+            *it = *(it - 1);
+    }
+
+    if (join == JoinStyle::Round)
+        drawRoundPolyline(points, thickness, color, depth);
+    else
+        drawMiterPolyline(points, thickness, color, depth);
+}
+
+void UIPainter::drawMiterPolyline(std::span<const glm::vec2> points, float thickness, const glm::vec4 &color,
+                                  int depth)
+{
+    // miters longer than this many half thicknesses are cut short, so sharp turns don't spike out
+    constexpr auto MiterLimit = 4.0f;
+
+    const auto halfThickness = 0.5f * thickness;
+    const auto &normals = m_polylineNormals;
+    const auto segmentCount = static_cast<int>(normals.size());
+    const auto pointCount = static_cast<int>(points.size());
+
+    // the line turns back on itself at an inner point whose segment normals cancel out
+    const auto isReversal = [&normals, pointCount](int i) {
+        if (i == 0 || i == pointCount - 1)
+            return false;
+        const auto sum = normals[i - 1] + normals[i];
+        return glm::dot(sum, sum) < 1e-6f;
+    };
+
+    // Each point gets a pair of corners, on the right and left side of the line. Inner points are offset along the
+    // bisector of the normals of their two segments, so that consecutive segment quads share their corners and meet
+    // without overlaps or gaps.
+    auto &corners = m_polylineCorners;
+    corners.resize(2 * points.size());
+    for (int i = 0; i < pointCount; ++i)
+    {
+        const auto &before = normals[i == 0 ? 0 : i - 1];
+        const auto &after = normals[std::min(i, segmentCount - 1)];
+        auto position = points[i];
+        glm::vec2 offset;
+        if (isReversal(i))
+        {
+            // square cap, the segment leaving the point uses the same corners swapped (see below)
+            position += halfThickness * glm::vec2(before.y, -before.x);
+            offset = halfThickness * before;
+        }
+        else
+        {
+            const auto sum = before + after;
+            const auto sumSquared = glm::dot(sum, sum);
+            // the miter length is 2 / |sum| half thicknesses
+            offset = sumSquared * MiterLimit * MiterLimit < 4.0f
+                         ? sum * (MiterLimit * halfThickness / std::sqrt(sumSquared))
+                         : sum * (2.0f * halfThickness / sumSquared);
+        }
+        corners[2 * i] = position - offset;
+        corners[2 * i + 1] = position + offset;
+    }
+    m_transform.map(corners.data(), corners.data(), corners.size());
+
     m_spriteBatcher->setBatchProgram(ShaderManager::Program::ThickLine);
+    const auto bgColor = glm::vec4(2.0f * thickness, 0, 0, 0);
+    for (int first = 0; first < segmentCount;)
+    {
+        const auto quads = m_spriteBatcher->reserveQuads(nullptr, segmentCount - first, depth);
+        std::size_t used = 0;
+        for (int i = first; i < first + static_cast<int>(quads.size()); ++i)
+        {
+            // past a reversal the right side of the line is the left side of the segment before
+            const auto reversed = isReversal(i);
+            const auto &p0 = corners[2 * i + (reversed ? 1 : 0)];
+            const auto &p1 = corners[2 * i + (reversed ? 0 : 1)];
+            const auto &p2 = corners[2 * i + 2];
+            const auto &p3 = corners[2 * i + 3];
+            if (isCulled(BoxF{glm::min(glm::min(p0, p1), glm::min(p2, p3)),
+                              glm::max(glm::max(p0, p1), glm::max(p2, p3))}))
+                continue;
+
+            auto &quad = quads[used++];
+            quad[0] = {p0, {0.0f, 0.0f}, color, bgColor, 0.0f};
+            quad[1] = {p2, {1.0f, 0.0f}, color, bgColor, 0.0f};
+            quad[2] = {p3, {1.0f, 1.0f}, color, bgColor, 0.0f};
+            quad[3] = {p1, {0.0f, 1.0f}, color, bgColor, 0.0f};
+        }
+        m_spriteBatcher->discardSprites(quads.size() - used);
+        first += quads.size();
+    }
+}
+
+void UIPainter::drawRoundPolyline(std::span<const glm::vec2> points, float thickness, const glm::vec4 &color,
+                                  int depth)
+{
+    // every segment is a capsule, whose rounded ends make up the joins where consecutive segments overlap
+    const auto halfThickness = 0.5f * thickness;
+    const auto &normals = m_polylineNormals;
+    const auto segmentCount = static_cast<int>(normals.size());
+    const auto &linear = m_transform.linear();
+
+    m_spriteBatcher->setBatchProgram(ShaderManager::Program::RoundedRectInstanced);
+    for (int first = 0; first < segmentCount;)
+    {
+        const auto instances = m_spriteBatcher->reserveInstances(nullptr, segmentCount - first, depth);
+        std::size_t used = 0;
+        for (int i = first; i < first + static_cast<int>(instances.size()); ++i)
+        {
+            const auto &from = points[i];
+            const auto &to = points[i + 1];
+            const auto bounds = BoxF{glm::min(from, to) - glm::vec2(halfThickness),
+                                     glm::max(from, to) + glm::vec2(halfThickness)};
+            if (isCulled(m_transform.mapBounds(bounds)))
+                continue;
+
+            // laid out along the x axis of a frame starting at from
+            const auto &normal = normals[i];
+            const auto direction = glm::vec2(normal.y, -normal.x);
+            const auto length = glm::dot(to - from, direction);
+
+            auto &instance = instances[used++];
+            instance.rect = BoxF{{-halfThickness, -halfThickness}, {length + halfThickness, halfThickness}};
+            instance.textureRect = BoxF{{halfThickness, 0.0f}, {0.0f, 0.0f}}; // radius, no border or blur
+            instance.fgColor = color;
+            instance.bgColor = glm::vec4(0);
+            instance.transform = glm::mat3x2(linear * direction, linear * normal, m_transform.map(from));
+            instance.textureLayer = 0.0f;
+        }
+        m_spriteBatcher->discardSprites(instances.size() - used);
+        first += instances.size();
+    }
+}
+
+int UIPainter::createLayer()
+{
+    return m_spriteBatcher->createLayer();
+}
+
+void UIPainter::releaseLayer(int layer)
+{
+    m_spriteBatcher->releaseLayer(layer);
+}
+
+void UIPainter::startLayer(int layer)
+{
+    saveTransform();
+    resetTransform();
+    m_spriteBatcher->startLayer(layer);
+    m_recordingLayer = true;
+    updateGlyphRasterizerThread();
+}
 
-    const auto dir = glm::normalize(to - from);
-    const auto tangent = glm::vec2(-dir.y, dir.x);
+void UIPainter::finishLayer()
+{
+    m_spriteBatcher->finishLayer();
+    m_recordingLayer = false;
+    updateGlyphRasterizerThread();
+    restoreTransform();
+}
 
-    const auto p0 = from - 0.5f * thickness * tangent;
-    const auto p1 = from + 0.5f * thickness * tangent;
+GlyphRasterizerThread *UIPainter::glyphRasterizerThread() const
+{
+    // layers are only recorded again when their contents change, so they can't wait for pending glyphs
+    return m_recordingLayer ? nullptr : m_glyphRasterizerThread.get();
+}
 
-    const auto p2 = to - 0.5f * thickness * tangent;
-    const auto p3 = to + 0.5f * thickness * tangent;
+void UIPainter::updateGlyphRasterizerThread()
+{
+    for (auto &[font, fontCache] : m_fonts)
+        fontCache->setRasterizerThread(glyphRasterizerThread());
+}
 
-    addQuad(nullptr, {p0, {0.0f, 0.0f}}, {p2, {1.0f, 0.0f}}, {p3, {1.0f, 1.0f}}, {p1, {0.0f, 1.0f}}, color,
-            {2.0f * thickness, 0, 0, 0}, depth);
+void UIPainter::drawLayer(int layer, const glm::vec4 &color, int depth)
+{
+    m_spriteBatcher->drawLayer(layer, m_transform.matrix4(), color, depth);
 }
 
 void UIPainter::updateSceneBox(int width, int height)
@@ -261,12 +642,12 @@ void UIPainter::updateSceneBox(int width, int height)
 
 void UIPainter::resetTransform()
 {
-    m_transform = glm::mat4(1);
+    m_transform.reset();
 }
 
 void UIPainter::scale(const glm::vec2 &s)
 {
-    m_transform = glm::scale(m_transform, glm::vec3(s, 1));
+    m_transform.scale(s);
 }
 
 void UIPainter::scale(float sx, float sy)
@@ -281,7 +662,7 @@ void UIPainter::scale(float s)
 
 void UIPainter::translate(const glm::vec2 &p)
 {
-    m_transform = glm::translate(m_transform, glm::vec3(p, 0));
+    m_transform.translate(p);
 }
 
 void UIPainter::translate(float dx, float dy)
@@ -291,7 +672,7 @@ void UIPainter::translate(float dx, float dy)
 
 void UIPainter::rotate(float angle)
 {
-    m_transform = glm::rotate(m_transform, angle, glm::vec3(0, 0, 1));
+    m_transform.rotate(angle);
 }
 
 void UIPainter::saveTransform()
@@ -310,66 +691,6 @@ void UIPainter::restoreTransform()
     m_transformStack.pop_back();
 }
 
-std::vector<UIPainter::TextRow> UIPainter::breakTextLines(const std::string &text, float maxWidth)
-{
-    assert(m_font);
-
-    std::vector<TextRow> rows;
-
-    using Position = std::pair<std::string::const_iterator, float>;
-
-    Position rowStart = {text.begin(), 0.0f};
-    std::optional<Position> lastBreak;
-
-    const auto spaceWidth = m_font->getGlyph(' ')->advanceWidth;
-
-    const auto makeRow = [](auto start, float xStart, auto end, float xEnd) {
-        return TextRow{std::string_view(&*start, std::distance(start, end)), xEnd - xStart};
-    };
-
-    float lineWidth = 0.0f;
-    for (auto it = text.begin(); it != text.end(); ++it)
-    {
-        const auto ch = *it;
-        if (ch == ' ')
-        {
-            if (lineWidth - rowStart.second > maxWidth)
-            {
-                if (lastBreak)
-                {
-                    rows.push_back(makeRow(rowStart.first, rowStart.second, lastBreak->first, lastBreak->second));
-                    rowStart = {lastBreak->first + 1, lastBreak->second + spaceWidth};
-                    lastBreak = {it, lineWidth};
-                }
-                else
-                {
-                    rows.push_back(makeRow(rowStart.first, rowStart.second, it, lineWidth));
-                    rowStart = {it + 1, lineWidth + spaceWidth};
-                }
-            }
-            else
-            {
-                lastBreak = {it, lineWidth};
-            }
-        }
-        lineWidth += m_font->getGlyph(ch)->advanceWidth;
-    }
-    if (rowStart.first != text.end())
-    {
-        if (lineWidth - rowStart.second > maxWidth && lastBreak)
-        {
-            rows.push_back(makeRow(rowStart.first, rowStart.second, lastBreak->first, lastBreak->second));
-            rows.push_back(makeRow(lastBreak->first + 1, lastBreak->second + spaceWidth, text.end(), lineWidth));
-        }
-        else
-        {
-            rows.push_back(makeRow(rowStart.first, rowStart.second, text.end(), lineWidth));
-        }
-    }
-
-    return rows;
-}
-
 void UIPainter::setVerticalAlign(VerticalAlign align)
 {
     m_verticalAlign = align;
@@ -385,5 +706,6 @@ std::size_t UIPainter::FontHasher::operator()(const Font &font) const
     std::size_t hash = 17;
     hash = hash * 31 + static_cast<std::size_t>(font.pixelHeight);
     hash = hash * 31 + std::hash<std::string>()(font.name);
+    hash = hash * 31 + static_cast<std::size_t>(font.distanceField);
     return hash;
 }
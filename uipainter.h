@@ -1,17 +1,26 @@
 #pragma once
 
 #include "noncopyable.h"
+#include "paragraphlayout.h"
 #include "shaderprogram.h"
+#include "spritebatcher.h"
+#include "transform2d.h"
 #include "util.h"
 
+#include <array>
 #include <memory>
+#include <span>
 #include <string_view>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 class TextureAtlas;
 class FontCache;
-class SpriteBatcher;
+class FontFace;
+class BakedFonts;
+class GlyphRunCache;
+class GlyphRasterizerThread;
 class ShaderManager;
 class AbstractTexture;
 
@@ -23,29 +32,90 @@ public:
 
     void resize(int width, int height);
 
-    void startPainting();
+    // Immediate mode draws everything in call order and ignores depth, which saves sorting when depth isn't used.
+    void startPainting(SpriteBatcher::SubmissionMode mode = SpriteBatcher::SubmissionMode::Sorted);
     void donePainting();
 
+    // Distance field fonts share a single set of glyphs between all their sizes.
     struct Font
     {
         std::string name;
         int pixelHeight;
-        bool operator==(const Font &other) const { return name == other.name && pixelHeight == other.pixelHeight; }
+        bool distanceField = false;
+        bool operator==(const Font &other) const
+        {
+            return name == other.name && pixelHeight == other.pixelHeight && distanceField == other.distanceField;
+        }
     };
     void setFont(const Font &font);
 
+    enum class VerticalAlign
+    {
+        Top,
+        Middle,
+        Bottom
+    };
+    void setVerticalAlign(VerticalAlign align);
+
+    enum class HorizontalAlign
+    {
+        Left,
+        Center,
+        Right
+    };
+    void setHorizontalAlign(HorizontalAlign align);
+
     template<typename StringT>
     void drawText(const glm::vec2 &pos, const glm::vec4 &color, int depth, const StringT &text);
 
+    // Draws text with pos.x at its left edge, center or right edge, and returns its advance. Measuring and drawing
+    // share a single glyph run lookup. The alignment set with setHorizontalAlign() only applies to text boxes.
+    template<typename StringT>
+    float drawText(const glm::vec2 &pos, const glm::vec4 &color, int depth, const StringT &text,
+                   HorizontalAlign align);
+
+    // Text broken at spaces into rows that fit the box width. The rows of recently drawn texts are cached; text that
+    // changes often (edit fields, logs) should bring its own layout, which only breaks again what follows an edit.
     void drawTextBox(const BoxF &box, const glm::vec4 &color, int depth, const std::string &text);
+    void drawTextBox(const BoxF &box, const glm::vec4 &color, int depth, const std::string &text,
+                     ParagraphLayout &layout);
 
     template<typename StringT>
     float horizontalAdvance(const StringT &text);
 
     void drawCircle(const glm::vec2 &center, float radius, const glm::vec4 &color, int depth);
+    // Drawn from a single quad. The border is drawn inside the box, and blur softens the edge over that distance on
+    // both sides, e.g. for drop shadows.
     void drawRoundedRect(const BoxF &box, float radius, const glm::vec4 &color, int depth);
+    void drawRoundedRect(const BoxF &box, float radius, const glm::vec4 &fillColor, float borderWidth,
+                         const glm::vec4 &borderColor, float blur, int depth);
     void drawThickLine(const glm::vec2 &from, const glm::vec2 &to, float thickness, const glm::vec4 &color, int depth);
 
+    // Connected line segments, all in one batch. Miter joins share the corners of consecutive segments, so nothing is
+    // drawn twice. Round joins draw each segment as a capsule, so translucent lines are darker where they overlap.
+    enum class JoinStyle
+    {
+        Miter,
+        Round
+    };
+    void drawPolyline(std::span<const glm::vec2> points, float thickness, const glm::vec4 &color, JoinStyle join,
+                      int depth);
+
+    // Retained layers, see SpriteBatcher. Everything drawn between startLayer() and finishLayer() is recorded
+    // (relative to an identity transform) instead of being added to the current frame, and drawLayer() replays it
+    // with the current transform and the given color multiplied in.
+    int createLayer();
+    void releaseLayer(int layer);
+    void startLayer(int layer);
+    void finishLayer();
+    void drawLayer(int layer, const glm::vec4 &color, int depth);
+
+    // Sprites whose bounds fall entirely outside the scene box are dropped before they reach the batcher. Cull rects
+    // (in scene coordinates) narrow that box further while they're pushed. Sprites straddling the edge are still drawn
+    // in full, nothing is clipped. Culling is off while recording a layer, since it can be drawn anywhere.
+    void pushCullRect(const BoxF &rect);
+    void popCullRect();
+
     void resetTransform();
     void scale(const glm::vec2 &s);
     void scale(float sx, float sy);
@@ -60,51 +130,51 @@ public:
     const FontCache *font() const { return m_font; }
     BoxF sceneBox() const { return m_sceneBox; }
 
-    enum class VerticalAlign
-    {
-        Top,
-        Middle,
-        Bottom
-    };
-    void setVerticalAlign(VerticalAlign align);
-
-    enum class HorizontalAlign
-    {
-        Left,
-        Center,
-        Right
-    };
-    void setHorizontalAlign(HorizontalAlign align);
-
 private:
-    struct Vertex
-    {
-        glm::vec2 position;
-        glm::vec2 textureCoords;
-    };
-    void addQuad(const AbstractTexture *texture, const Vertex &v0, const Vertex &v1, const Vertex &v2, const Vertex &v3,
-                 const glm::vec4 &fgColor, const glm::vec4 &bgColor, int depth);
+    bool isCulled(const BoxF &bounds) const;
+    void drawMiterPolyline(std::span<const glm::vec2> points, float thickness, const glm::vec4 &color, int depth);
+    void drawRoundPolyline(std::span<const glm::vec2> points, float thickness, const glm::vec4 &color, int depth);
+    void updateCullBox();
+    GlyphRasterizerThread *glyphRasterizerThread() const;
+    void updateGlyphRasterizerThread();
 
     void updateSceneBox(int width, int height);
+    std::shared_ptr<FontFace> fontFace(const std::string &name);
 
-    struct TextRow
-    {
-        std::string_view text;
-        float width;
-    };
-    std::vector<TextRow> breakTextLines(const std::string &text, float lineWidth);
+    void drawParagraph(const BoxF &box, const glm::vec4 &color, int depth, const ParagraphLayout &layout);
 
     struct FontHasher
     {
         std::size_t operator()(const Font &font) const;
     };
     std::unordered_map<Font, std::unique_ptr<FontCache>, FontHasher> m_fonts;
+    std::unordered_set<Font, FontHasher> m_failedFonts;
+    Font m_fontKey = {}; // scratch for setFont()
+    // font files are parsed once and shared by all the sizes in use
+    std::unordered_map<std::string, std::weak_ptr<FontFace>> m_fontFaces;
     std::unique_ptr<SpriteBatcher> m_spriteBatcher;
     std::unique_ptr<TextureAtlas> m_textureAtlas;
+    std::unique_ptr<GlyphRunCache> m_glyphRunCache;
+    struct ParagraphLayoutEntry
+    {
+        ParagraphLayout layout;
+        unsigned lastUsed = 0;
+    };
+    std::array<ParagraphLayoutEntry, 16> m_paragraphLayouts;
+    unsigned m_paragraphLayoutClock = 0;
+    std::unique_ptr<BakedFonts> m_bakedFonts;
+    // declared after m_fonts so that it's stopped before the font faces it reads from are released
+    std::unique_ptr<GlyphRasterizerThread> m_glyphRasterizerThread;
     BoxF m_sceneBox = {};
+    BoxF m_cullBox = {};
+    std::vector<BoxF> m_cullRectStack;
+    bool m_recordingLayer = false;
+    std::vector<glm::vec2> m_polylineNormals; // scratch for drawPolyline()
+    std::vector<glm::vec2> m_polylineCorners;
     FontCache *m_font = nullptr;
-    glm::mat4 m_transform;
-    std::vector<glm::mat4> m_transformStack;
+    float m_fontScale = 1.0f; // from the metrics of m_font to the pixel height that was asked for
+    Transform2D m_transform;
+    std::vector<Transform2D> m_transformStack;
     VerticalAlign m_verticalAlign = VerticalAlign::Top;
     HorizontalAlign m_horizontalAlign = HorizontalAlign::Left;
 };
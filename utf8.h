@@ -0,0 +1,115 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace Util
+{
+// Number of ASCII bytes at the start of [begin, end).
+inline std::size_t asciiPrefixLength(const char *begin, const char *end)
+{
+    const char *p = begin;
+#if defined(__SSE2__)
+    for (; end - p >= 16; p += 16)
+    {
+        const auto mask = _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p)));
+        if (mask != 0)
+            return p - begin + std::countr_zero(static_cast<unsigned>(mask));
+    }
+#else
+    for (; end - p >= 8; p += 8)
+    {
+        std::uint64_t word;
+        std::memcpy(&word, p, sizeof(word));
+        if (word & 0x8080808080808080ull)
+            break;
+    }
+#endif
+    while (p != end && static_cast<unsigned char>(*p) < 0x80)
+        ++p;
+    return p - begin;
+}
+
+// Decodes the codepoint starting at p and moves p past it. Malformed or truncated sequences decode to U+FFFD and only
+// consume their first byte. Well formed sequences encoding an invalid codepoint (overlong forms, surrogates, anything
+// past U+10FFFF) are consumed whole and decode to a single U+FFFD.
+inline char32_t decodeUtf8(const char *&p, const char *end)
+{
+    constexpr char32_t Replacement = 0xfffd;
+
+    const auto lead = static_cast<unsigned char>(*p++);
+    if (lead < 0x80)
+        return lead;
+
+    int length;
+    char32_t codepoint;
+    char32_t minimum;
+    if ((lead & 0xe0) == 0xc0)
+    {
+        length = 1;
+        codepoint = lead & 0x1f;
+        minimum = 0x80;
+    }
+    else if ((lead & 0xf0) == 0xe0)
+    {
+        length = 2;
+        codepoint = lead & 0x0f;
+        minimum = 0x800;
+    }
+    else if ((lead & 0xf8) == 0xf0)
+    {
+        length = 3;
+        codepoint = lead & 0x07;
+        minimum = 0x10000;
+    }
+    else
+    {
+        return Replacement;
+    }
+
+    if (end - p < length)
+        return Replacement;
+    for (int i = 0; i < length; ++i)
+    {
+        const auto byte = static_cast<unsigned char>(p[i]);
+        if ((byte & 0xc0) != 0x80)
+            return Replacement;
+        codepoint = (codepoint << 6) | (byte & 0x3f);
+    }
+    p += length;
+
+    // overlong encodings, surrogates and anything past the last plane
+    if (codepoint < minimum || codepoint > 0x10ffff || (codepoint >= 0xd800 && codepoint <= 0xdfff))
+        return Replacement;
+    return codepoint;
+}
+
+// Calls f(codepoint, offset) for each codepoint in text, where offset is the position of its first byte. Runs of
+// ASCII are skipped over in blocks and handed out without going through the decoder.
+template<typename Function>
+void forEachCodepoint(std::string_view text, Function &&f)
+{
+    const auto *begin = text.data();
+    const auto *end = begin + text.size();
+    const auto *p = begin;
+    while (p != end)
+    {
+        const auto *asciiEnd = p + asciiPrefixLength(p, end);
+        for (; p != asciiEnd; ++p)
+            f(static_cast<char32_t>(*p), static_cast<std::size_t>(p - begin));
+        if (p != end)
+        {
+            const auto offset = static_cast<std::size_t>(p - begin);
+            f(decodeUtf8(p, end), offset);
+        }
+    }
+}
+
+} // namespace Util
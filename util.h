@@ -43,7 +43,21 @@ struct Box
         return *this;
     }
 
+    // may end up empty (min > max), which intersects nothing
+    Box &operator&=(const Box &rhs)
+    {
+        min = glm::max(min, rhs.min);
+        max = glm::min(max, rhs.max);
+        return *this;
+    }
+
     bool contains(const Point &p) { return p.x >= min.x && p.x < max.x && p.y >= min.y && p.y < max.y; }
+
+    // touching boxes count as intersecting
+    bool intersects(const Box &other) const
+    {
+        return min.x <= other.max.x && other.min.x <= max.x && min.y <= other.max.y && other.min.y <= max.y;
+    }
 };
 
 template<typename Point>
@@ -60,6 +74,13 @@ inline Box<Point> operator|(Box<Point> lhs, const Box<Point> &rhs)
     return lhs;
 }
 
+template<typename Point>
+inline Box<Point> operator&(Box<Point> lhs, const Box<Point> &rhs)
+{
+    lhs &= rhs;
+    return lhs;
+}
+
 using BoxF = Box<glm::vec2>;
 using BoxI = Box<glm::ivec2>;
 